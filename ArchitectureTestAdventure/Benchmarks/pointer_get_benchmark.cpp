@@ -0,0 +1,136 @@
+/*=================================================
+
+    Copyright (C) 2025 Farrakh. All Rights Reserved.
+
+    This file is a part of ArchitectureTestAdventure.
+    Check README.md for more information.
+
+    File : pointer_get_benchmark.cpp
+
+    Content : get() throughput of typed_pointer_storage
+    from 1 to N reader threads, lock-free against the
+    shared_mutex path it replaced. Standalone : build
+    with the Core directory on the include path, e.g.
+    g++ -std=c++20 -O2 -I../Code/Core pointer_get_benchmark.cpp
+
+=================================================*/
+
+#include <pointer.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <shared_mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace {
+    constexpr size_t OBJECT_COUNT     = 1 << 16;
+    constexpr size_t LOOKUPS_PER_PASS = 1 << 12;
+    constexpr auto   RUN_TIME         = std::chrono::milliseconds(500);
+
+    struct object {
+        uint64_t value[4];
+    };
+
+    using storage_t = ata::typed_pointer_storage<object>;
+    using pointer_t = storage_t::pointer_t;
+
+    // the read path before get() went lock-free : every lookup takes the storage lock shared
+    class locked_lookup {
+    public:
+        explicit locked_lookup(const storage_t& storage) : m_storage(storage) {}
+
+        const object* get(pointer_t handle) const noexcept {
+            std::shared_lock lock(m_mutex);
+            return m_storage.get(handle);
+        }
+
+    private:
+        const storage_t&          m_storage;
+        mutable std::shared_mutex m_mutex;
+    };
+
+    struct lock_free_lookup {
+        const storage_t& storage;
+
+        const object* get(pointer_t handle) const noexcept { return storage.get(handle); }
+    };
+
+    // lookups per second over RUN_TIME with 'threads' readers, each walking its own shuffled handle order
+    template <typename _Lookup>
+    double measure(const _Lookup& lookup, const std::vector<pointer_t>& handles, size_t threads) {
+        std::atomic<bool>     start{ false };
+        std::atomic<bool>     stop{ false };
+        std::atomic<uint64_t> total{ 0 };
+        std::atomic<uint64_t> sink{ 0 };
+
+        std::vector<std::thread> workers;
+        for (size_t t = 0; t < threads; t++) {
+            workers.emplace_back([&, t]() {
+                std::vector<pointer_t> order = handles;
+                std::shuffle(order.begin(), order.end(), std::mt19937_64(t + 1));
+
+                while (!start.load(std::memory_order_acquire)) std::this_thread::yield();
+
+                uint64_t lookups = 0;
+                uint64_t sum     = 0;
+                size_t   cursor  = 0;
+                while (!stop.load(std::memory_order_relaxed)) {
+                    for (size_t i = 0; i < LOOKUPS_PER_PASS; i++) {
+                        const object* found = lookup.get(order[cursor]);
+                        sum += found != nullptr ? found->value[0] : 0;
+                        cursor = cursor + 1 == order.size() ? 0 : cursor + 1;
+                    }
+                    lookups += LOOKUPS_PER_PASS;
+                }
+
+                total.fetch_add(lookups, std::memory_order_relaxed);
+                sink.fetch_add(sum, std::memory_order_relaxed);
+            });
+        }
+
+        auto begin = std::chrono::steady_clock::now();
+        start.store(true, std::memory_order_release);
+        std::this_thread::sleep_for(RUN_TIME);
+        stop.store(true, std::memory_order_relaxed);
+        for (auto& worker : workers) worker.join();
+        auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+        if (sink.load() == 0) std::puts(""); // keeps the loads from being optimized out
+        return double(total.load()) / elapsed;
+    }
+} // namespace
+
+// usage : pointer_get_benchmark [ max_threads ], defaults to the hardware concurrency
+int main(int argc, char** argv) {
+    size_t max_threads = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : std::thread::hardware_concurrency();
+    if (max_threads == 0) max_threads = 1;
+
+    storage_t              storage;
+    std::vector<pointer_t> handles;
+    handles.reserve(OBJECT_COUNT);
+    for (size_t i = 0; i < OBJECT_COUNT; i++) handles.push_back(storage.create(object{ { i + 1, 0, 0, 0 } }));
+
+    locked_lookup    locked{ storage };
+    lock_free_lookup lock_free{ storage };
+
+    // powers of two, then max_threads itself
+    std::vector<size_t> thread_counts;
+    for (size_t threads = 1; threads < max_threads; threads *= 2) thread_counts.push_back(threads);
+    thread_counts.push_back(max_threads);
+
+    std::printf("%8s %16s %16s %8s\n", "threads", "locked Mget/s", "lock-free Mget/s", "speedup");
+
+    for (size_t threads : thread_counts) {
+        double locked_rate    = measure(locked, handles, threads);
+        double lock_free_rate = measure(lock_free, handles, threads);
+        std::printf("%8zu %16.1f %16.1f %7.2fx\n", threads, locked_rate / 1e6, lock_free_rate / 1e6, lock_free_rate / locked_rate);
+    }
+    return 0;
+}
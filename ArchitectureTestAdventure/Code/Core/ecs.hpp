@@ -0,0 +1,684 @@
+/*=================================================
+
+    Copyright (C) 2025 Farrakh. All Rights Reserved.
+
+    This file is a part of ArchitectureTestAdventure.
+    Check README.md for more information.
+
+    File : ecs.hpp
+
+    Content : archetype based entity component system
+    on top of ata::pointer entity ids.
+
+=================================================*/
+
+#pragma once
+#include <pointer.hpp>
+
+#include <bitset>
+#include <vector>
+#include <array>
+#include <tuple>
+#include <span>
+#include <mutex>
+#include <memory>
+#include <memory_resource>
+#include <unordered_map>
+#include <type_traits>
+#include <utility>
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+
+namespace ata::ecs {
+    constexpr size_t MAX_COMPONENT_TYPES = 256;
+
+    using component_mask = std::bitset<MAX_COMPONENT_TYPES>;
+
+    template <typename _Ty>
+    concept is_component_v = is_storable_v<_Ty> && (!std::is_const_v<_Ty>);
+
+    class archetype;
+    class world;
+    class command_buffer;
+
+    // where the components of an entity live. 'owner' is nullptr for an entity created by a
+    // command_buffer that was not flushed yet
+    struct entity_location {
+    public:
+        archetype* owner = nullptr;
+        uint32_t   chunk = 0;
+        uint32_t   row   = 0;
+    };
+
+    using entity = pointer<entity_location>;
+
+    // dense process-wide ids for component types, assigned on first use
+    class component_type_id {
+    public:
+        template <typename _Ty>
+        static uint32_t get() noexcept {
+            static const uint32_t id = checked(NEXT_ID.fetch_add(1, std::memory_order_relaxed));
+            return id;
+        }
+
+    private:
+        // the id indexes fixed-size masks and column tables, so running out is fatal in every build
+        static uint32_t checked(uint32_t id) noexcept {
+            if (id >= MAX_COMPONENT_TYPES) {
+                std::fputs("component_type_id::get() : too many component types, raise MAX_COMPONENT_TYPES\n", stderr);
+                std::abort();
+            }
+            return id;
+        }
+
+    private:
+        inline static std::atomic<uint32_t> NEXT_ID{ 0 };
+    };
+
+    // type-erased operations an archetype needs to move rows between chunks and archetypes
+    struct component_info {
+    public:
+        uint32_t id;
+        size_t   size;
+        size_t   alignment;
+        void (*move_construct)(void* destination, void* source);
+        void (*destroy)(void* object);
+
+        template <is_component_v _Ty>
+        static const component_info& of() noexcept {
+            static const component_info info{
+                component_type_id::get<_Ty>(),
+                sizeof(_Ty),
+                alignof(_Ty),
+                [](void* destination, void* source) { ::new (destination) _Ty(std::move(*static_cast<_Ty*>(source))); },
+                [](void* object) { static_cast<_Ty*>(object)->~_Ty(); }
+            };
+            return info;
+        }
+    };
+
+    // every entity with exactly the same set of components. Rows are packed into fixed-size chunks,
+    // and inside a chunk each component type is one contiguous column ( structure of arrays ).
+    // Every chunk but the last is full : removing a row moves the very last row into the hole
+    class archetype {
+    public:
+        constexpr static size_t CHUNK_BYTES     = 16 * 1024;
+        constexpr static size_t CHUNK_ALIGNMENT = 64;
+
+        // 'components' sorted by id
+        archetype(const component_mask& mask, std::vector<const component_info*> components, std::pmr::memory_resource* resource)
+            : m_mask(mask), m_components(std::move(components)), m_offsets(m_components.size()), m_chunks(resource), m_resource(resource) {
+            m_columns.fill(NO_COLUMN);
+            for (size_t column = 0; column < m_components.size(); column++) {
+                assert(m_components[column]->alignment <= CHUNK_ALIGNMENT && "archetype : component alignment is above the chunk alignment");
+                m_columns[m_components[column]->id] = static_cast<uint16_t>(column);
+            }
+
+            size_t row_bytes = sizeof(entity);
+            for (const auto* component : m_components) row_bytes += component->size;
+
+            m_capacity = static_cast<uint32_t>(CHUNK_BYTES / row_bytes);
+            while (m_capacity > 0 && layout(m_capacity) > CHUNK_BYTES) m_capacity--;
+            assert(m_capacity > 0 && "archetype : a single row does not fit into a chunk");
+            layout(m_capacity);
+        }
+
+        ~archetype() {
+            for (uint32_t chunk = 0; chunk < m_chunks.size(); chunk++) {
+                for (size_t column = 0; column < m_components.size(); column++) {
+                    for (uint32_t row = 0; row < m_chunks[chunk].count; row++) m_components[column]->destroy(component(chunk, row, column));
+                }
+                m_resource->deallocate(m_chunks[chunk].data, CHUNK_BYTES, CHUNK_ALIGNMENT);
+            }
+        }
+
+        archetype(const archetype&)            = delete;
+        archetype& operator=(const archetype&) = delete;
+
+        const component_mask& mask() const noexcept { return m_mask; }
+        uint32_t              chunk_capacity() const noexcept { return m_capacity; }
+        uint32_t              chunk_count() const noexcept { return static_cast<uint32_t>(m_chunks.size()); }
+        uint32_t              row_count(uint32_t chunk) const noexcept { return m_chunks[chunk].count; }
+
+        size_t size() const noexcept {
+            return m_chunks.empty() ? 0 : (m_chunks.size() - 1) * m_capacity + m_chunks.back().count;
+        }
+
+        std::span<const component_info* const> components() const noexcept { return m_components; }
+
+        // column of a component type, or NO_COLUMN
+        uint16_t column_of(uint32_t id) const noexcept { return m_columns[id]; }
+
+        const entity* entities(uint32_t chunk) const noexcept { return std::launder(reinterpret_cast<const entity*>(m_chunks[chunk].data)); }
+        std::byte*    column_data(uint32_t chunk, size_t column) const noexcept { return m_chunks[chunk].data + m_offsets[column]; }
+
+        void* component(uint32_t chunk, uint32_t row, size_t column) const noexcept {
+            return column_data(chunk, column) + row * m_components[column]->size;
+        }
+
+        constexpr static uint16_t NO_COLUMN = 0xFFFF;
+
+    private:
+        friend class world;
+
+        struct _MyChunk {
+            std::byte* data;
+            uint32_t   count;
+        };
+
+        // bytes used by 'capacity' rows. Also fills m_offsets
+        size_t layout(uint32_t capacity) noexcept {
+            size_t offset = sizeof(entity) * capacity;
+            for (size_t column = 0; column < m_components.size(); column++) {
+                size_t alignment = m_components[column]->alignment;
+                offset           = (offset + alignment - 1) / alignment * alignment;
+
+                m_offsets[column] = offset;
+                offset += m_components[column]->size * capacity;
+            }
+            return offset;
+        }
+
+        // appends a row for 'owner' and returns its chunk and row. The components are left unconstructed
+        std::pair<uint32_t, uint32_t> push_row(entity owner) {
+            if (m_chunks.empty() || m_chunks.back().count == m_capacity) {
+                auto* data = static_cast<std::byte*>(m_resource->allocate(CHUNK_BYTES, CHUNK_ALIGNMENT));
+                m_chunks.push_back(_MyChunk{ data, 0 });
+            }
+
+            uint32_t chunk = static_cast<uint32_t>(m_chunks.size() - 1);
+            uint32_t row   = m_chunks[chunk].count++;
+            ::new (static_cast<void*>(m_chunks[chunk].data + row * sizeof(entity))) entity(owner);
+            return { chunk, row };
+        }
+
+        // the components of the row must already be moved out or destroyed. The last row is moved into
+        // the hole; returns its entity, or a null entity if the removed row was the last one
+        entity remove_row(uint32_t chunk, uint32_t row) {
+            uint32_t last_chunk = static_cast<uint32_t>(m_chunks.size() - 1);
+            uint32_t last_row   = m_chunks[last_chunk].count - 1;
+
+            entity moved{};
+            if (chunk != last_chunk || row != last_row) {
+                for (size_t column = 0; column < m_components.size(); column++) {
+                    m_components[column]->move_construct(component(chunk, row, column), component(last_chunk, last_row, column));
+                    m_components[column]->destroy(component(last_chunk, last_row, column));
+                }
+
+                moved = entities(last_chunk)[last_row];
+                ::new (static_cast<void*>(m_chunks[chunk].data + row * sizeof(entity))) entity(moved);
+            }
+
+            if (--m_chunks[last_chunk].count == 0) {
+                m_resource->deallocate(m_chunks[last_chunk].data, CHUNK_BYTES, CHUNK_ALIGNMENT);
+                m_chunks.pop_back();
+            }
+            return moved;
+        }
+
+    private:
+        component_mask                            m_mask;
+        std::vector<const component_info*>        m_components;
+        std::vector<size_t>                       m_offsets; // of every column inside a chunk. The entity column is at 0
+        std::array<uint16_t, MAX_COMPONENT_TYPES> m_columns;
+
+        uint32_t                   m_capacity{ 0 };
+        std::pmr::vector<_MyChunk> m_chunks;
+
+        // archetype reached by adding or removing one component, filled on first use
+        std::unordered_map<uint32_t, archetype*> m_addEdges;
+        std::unordered_map<uint32_t, archetype*> m_removeEdges;
+
+        std::pmr::memory_resource* m_resource;
+    };
+
+    // owns the entities and their archetypes. Structural changes ( create, destroy, add, remove ) must
+    // not run concurrently with each other or with a query; from inside systems record them into a
+    // command_buffer and flush it afterwards. Component values may be written during queries
+    class world {
+    public:
+        explicit world(std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+            : m_resource(resource), m_entities(resource), m_archetypes(resource) {}
+        ~world() = default;
+
+        world(const world&)            = delete;
+        world& operator=(const world&) = delete;
+
+        std::pmr::memory_resource* resource() const noexcept { return m_resource; }
+
+        template <is_component_v... _Cs>
+        entity create(_Cs... components) {
+            entity result = m_entities.create(entity_location{});
+            place(result, *m_entities.get(result), std::move(components)...);
+            return result;
+        }
+
+        void destroy(entity target) {
+            entity_location* location = m_entities.get(target);
+            if (location == nullptr) return;
+
+            if (location->owner != nullptr) {
+                archetype& owner = *location->owner;
+                for (size_t column = 0; column < owner.m_components.size(); column++) {
+                    owner.m_components[column]->destroy(owner.component(location->chunk, location->row, column));
+                }
+                relocate_moved(owner.remove_row(location->chunk, location->row), *location);
+            }
+
+            m_entities.destroy(target);
+        }
+
+        bool is_alive(entity target) const noexcept {
+            return m_entities.is_valid(target);
+        }
+
+        template <is_component_v _Ty>
+        _Ty* get(entity target) noexcept {
+            const entity_location* location = m_entities.get(target);
+            if (location == nullptr || location->owner == nullptr) return nullptr;
+
+            uint16_t column = location->owner->column_of(component_type_id::get<_Ty>());
+            if (column == archetype::NO_COLUMN) return nullptr;
+            return std::launder(static_cast<_Ty*>(location->owner->component(location->chunk, location->row, column)));
+        }
+
+        template <is_component_v _Ty>
+        bool has(entity target) const noexcept {
+            const entity_location* location = m_entities.get(target);
+            return location != nullptr && location->owner != nullptr && location->owner->mask().test(component_type_id::get<_Ty>());
+        }
+
+        // replaces the component if the entity already has one
+        template <is_component_v _Ty>
+        void add(entity target, _Ty value) {
+            entity_location* location = m_entities.get(target);
+            if (location == nullptr) return;
+
+            uint32_t id = component_type_id::get<_Ty>();
+            if (_Ty* existing = get<_Ty>(target)) {
+                existing->~_Ty();
+                ::new (static_cast<void*>(existing)) _Ty(std::move(value));
+                return;
+            }
+
+            archetype* source = location->owner;
+            archetype* target_archetype;
+            if (source != nullptr && source->m_addEdges.contains(id)) {
+                target_archetype = source->m_addEdges[id];
+            }
+            else {
+                component_mask                     mask = source != nullptr ? source->mask() : component_mask{};
+                std::vector<const component_info*> components;
+                if (source != nullptr) components.assign(source->m_components.begin(), source->m_components.end());
+
+                mask.set(id);
+                components.push_back(&component_info::of<_Ty>());
+                target_archetype = &find_or_create_archetype(mask, std::move(components));
+                if (source != nullptr) source->m_addEdges[id] = target_archetype;
+            }
+
+            move_to(*location, *target_archetype, target);
+            archetype& owner = *location->owner;
+            ::new (owner.component(location->chunk, location->row, owner.column_of(id))) _Ty(std::move(value));
+        }
+
+        template <is_component_v _Ty>
+        void remove(entity target) {
+            entity_location* location = m_entities.get(target);
+            if (location == nullptr || location->owner == nullptr) return;
+
+            archetype& source = *location->owner;
+            uint32_t   id     = component_type_id::get<_Ty>();
+            uint16_t   column = source.column_of(id);
+            if (column == archetype::NO_COLUMN) return;
+
+            archetype* target_archetype;
+            if (source.m_removeEdges.contains(id)) {
+                target_archetype = source.m_removeEdges[id];
+            }
+            else {
+                component_mask                     mask = source.mask();
+                std::vector<const component_info*> components;
+                for (const auto* component : source.m_components) {
+                    if (component->id != id) components.push_back(component);
+                }
+
+                mask.reset(id);
+                target_archetype         = &find_or_create_archetype(mask, std::move(components));
+                source.m_removeEdges[id] = target_archetype;
+            }
+
+            source.m_components[column]->destroy(source.component(location->chunk, location->row, column));
+            move_to(*location, *target_archetype, target);
+        }
+
+        // applies and clears every command recorded into 'commands', in recording order
+        void flush(command_buffer& commands);
+
+        size_t entity_count() const noexcept { return m_entities.live_count(); }
+        size_t archetype_count() const noexcept { return m_archetypes.size(); }
+
+    private:
+        template <typename... _Cs>
+        friend class query;
+        friend class command_buffer;
+
+        template <is_component_v... _Cs>
+        void place(entity target, entity_location& location, _Cs&&... components) {
+            component_mask mask;
+            (mask.set(component_type_id::get<_Cs>()), ...);
+            assert(mask.count() == sizeof...(_Cs) && "world::create() : a component type is given twice");
+
+            auto       it    = m_lookup.find(mask);
+            archetype& owner = it != m_lookup.end() ? *it->second : find_or_create_archetype(mask, { &component_info::of<_Cs>()... });
+
+            auto [chunk, row] = owner.push_row(target);
+            location          = entity_location{ &owner, chunk, row };
+            (::new (owner.component(chunk, row, owner.column_of(component_type_id::get<_Cs>()))) _Cs(std::move(components)), ...);
+        }
+
+        // moves the row of 'target' into 'destination'. Components the destination does not have must
+        // already be destroyed; components it has beyond the source are left unconstructed
+        void move_to(entity_location& location, archetype& destination, entity target) {
+            auto [chunk, row] = destination.push_row(target);
+
+            if (location.owner != nullptr) {
+                archetype& source = *location.owner;
+                for (size_t column = 0; column < source.m_components.size(); column++) {
+                    const component_info* component = source.m_components[column];
+
+                    uint16_t destination_column = destination.column_of(component->id);
+                    if (destination_column == archetype::NO_COLUMN) continue; // destroyed by the caller
+
+                    void* from = source.component(location.chunk, location.row, column);
+                    component->move_construct(destination.component(chunk, row, destination_column), from);
+                    component->destroy(from);
+                }
+                relocate_moved(source.remove_row(location.chunk, location.row), location);
+            }
+
+            location = entity_location{ &destination, chunk, row };
+        }
+
+        // the entity that remove_row() moved into the hole at 'hole' now lives there
+        void relocate_moved(entity moved, const entity_location& hole) {
+            if (moved == entity{}) return;
+
+            entity_location* location = m_entities.get(moved);
+            location->chunk           = hole.chunk;
+            location->row             = hole.row;
+        }
+
+        archetype& find_or_create_archetype(const component_mask& mask, std::vector<const component_info*> components) {
+            auto it = m_lookup.find(mask);
+            if (it != m_lookup.end()) return *it->second;
+
+            std::sort(components.begin(), components.end(), [](const component_info* a, const component_info* b) { return a->id < b->id; });
+
+            archetype* created = m_archetypes.emplace_back(make_pmr_unique<archetype>(m_resource, mask, std::move(components), m_resource)).get();
+            m_lookup.emplace(mask, created);
+            return *created;
+        }
+
+    private:
+        std::pmr::memory_resource* m_resource;
+
+        typed_pointer_storage<entity_location> m_entities;
+
+        std::pmr::vector<pmr_unique_ptr<archetype>>    m_archetypes; // in creation order, queries pick up new ones incrementally
+        std::unordered_map<component_mask, archetype*> m_lookup;
+    };
+
+    // structural changes recorded while queries run, applied later by world::flush(). Recording is
+    // thread-safe, but one buffer per worker avoids the lock. Entities created through a buffer get
+    // their handle immediately; their components are attached at flush
+    class command_buffer {
+    public:
+        explicit command_buffer(world& target) : m_world(&target) {}
+        ~command_buffer() = default;
+
+        command_buffer(const command_buffer&)            = delete;
+        command_buffer& operator=(const command_buffer&) = delete;
+
+        entity create() {
+            return m_world->m_entities.create(entity_location{});
+        }
+
+        template <is_component_v _Ty>
+        void add(entity target, _Ty value) {
+            push([target, value = std::move(value)](world& owner) mutable { owner.add(target, std::move(value)); });
+        }
+
+        template <is_component_v _Ty>
+        void remove(entity target) {
+            push([target](world& owner) { owner.remove<_Ty>(target); });
+        }
+
+        void destroy(entity target) {
+            push([target](world& owner) { owner.destroy(target); });
+        }
+
+        bool empty() const noexcept {
+            std::unique_lock lock(m_mutex);
+            return m_commands.empty();
+        }
+
+    private:
+        friend class world;
+
+        struct _MyCommand {
+            virtual ~_MyCommand()           = default;
+            virtual void apply(world& owner) = 0;
+        };
+
+        template <typename _Fn>
+        struct _MyCommandImpl : _MyCommand {
+            _Fn fn;
+
+            explicit _MyCommandImpl(_Fn&& fn) : fn(std::move(fn)) {}
+            void apply(world& owner) override { fn(owner); }
+        };
+
+        template <typename _Fn>
+        void push(_Fn&& fn) {
+            auto command = std::make_unique<_MyCommandImpl<std::decay_t<_Fn>>>(std::forward<_Fn>(fn));
+
+            std::unique_lock lock(m_mutex);
+            m_commands.push_back(std::move(command));
+        }
+
+    private:
+        world* m_world;
+
+        std::vector<std::unique_ptr<_MyCommand>> m_commands;
+        mutable std::mutex                       m_mutex;
+    };
+
+    inline void world::flush(command_buffer& commands) {
+        std::vector<std::unique_ptr<command_buffer::_MyCommand>> recorded;
+        {
+            std::unique_lock lock(commands.m_mutex);
+            recorded.swap(commands.m_commands);
+        }
+
+        for (auto& command : recorded) command->apply(*this);
+    }
+
+    // every entity that has all of _Cs. A const component is only read, which lets a schedule run
+    // the query next to other readers. The matching archetypes are cached and new ones are picked
+    // up incrementally, so a query is meant to be kept and reused
+    template <typename... _Cs>
+    class query {
+    public:
+        static_assert((is_component_v<std::remove_const_t<_Cs>> && ...), "query : every type must be a component");
+
+        explicit query(world& target) : m_world(&target) {}
+        ~query() = default;
+
+        static component_mask reads() noexcept {
+            component_mask mask;
+            ((std::is_const_v<_Cs> ? mask.set(component_type_id::get<std::remove_const_t<_Cs>>()) : mask), ...);
+            return mask;
+        }
+
+        static component_mask writes() noexcept {
+            component_mask mask;
+            ((!std::is_const_v<_Cs> ? mask.set(component_type_id::get<std::remove_const_t<_Cs>>()) : mask), ...);
+            return mask;
+        }
+
+        // calls fn(entity, _Cs&...) for every matching entity, streaming chunk by chunk
+        template <typename _Fn>
+        void each(_Fn&& fn) {
+            each_chunk([&](std::span<const entity> entities, std::span<_Cs>... columns) {
+                for (size_t row = 0; row < entities.size(); row++) fn(entities[row], columns[row]...);
+            });
+        }
+
+        // calls fn(std::span<const entity>, std::span<_Cs>...) once per chunk : the columns are dense arrays
+        template <typename _Fn>
+        void each_chunk(_Fn&& fn) {
+            refresh();
+            for (const auto& match : m_matches) {
+                for (uint32_t chunk = 0; chunk < match.owner->chunk_count(); chunk++) {
+                    run_chunk(match, chunk, fn, std::index_sequence_for<_Cs...>{});
+                }
+            }
+        }
+
+        // same as each_chunk, with the chunks spread over 'executor'. executor(task_count, task) must
+        // call task(i) once for every i in [0, task_count), on any threads, and return after all of them
+        // finished - the contract typed_pointer_storage::parallel_for_each uses
+        template <typename _Executor, typename _Fn>
+        void parallel_each_chunk(_Executor&& executor, _Fn&& fn) {
+            refresh();
+
+            m_tasks.clear();
+            for (const auto& match : m_matches) {
+                for (uint32_t chunk = 0; chunk < match.owner->chunk_count(); chunk++) m_tasks.push_back({ &match, chunk });
+            }
+            if (m_tasks.empty()) return;
+
+            executor(m_tasks.size(), [&](size_t task) {
+                run_chunk(*m_tasks[task].first, m_tasks[task].second, fn, std::index_sequence_for<_Cs...>{});
+            });
+        }
+
+        template <typename _Executor, typename _Fn>
+        void parallel_each(_Executor&& executor, _Fn&& fn) {
+            parallel_each_chunk(executor, [&](std::span<const entity> entities, std::span<_Cs>... columns) {
+                for (size_t row = 0; row < entities.size(); row++) fn(entities[row], columns[row]...);
+            });
+        }
+
+        size_t count() {
+            refresh();
+
+            size_t result = 0;
+            for (const auto& match : m_matches) result += match.owner->size();
+            return result;
+        }
+
+    private:
+        struct _MyMatch {
+            archetype*                           owner;
+            std::array<uint16_t, sizeof...(_Cs)> columns;
+        };
+
+        void refresh() {
+            component_mask mask = reads() | writes();
+            for (; m_seen < m_world->m_archetypes.size(); m_seen++) {
+                archetype* candidate = m_world->m_archetypes[m_seen].get();
+                if ((candidate->mask() & mask) != mask) continue;
+
+                m_matches.push_back(_MyMatch{ candidate, { candidate->column_of(component_type_id::get<std::remove_const_t<_Cs>>())... } });
+            }
+        }
+
+        template <typename _Fn, size_t... _Is>
+        static void run_chunk(const _MyMatch& match, uint32_t chunk, _Fn& fn, std::index_sequence<_Is...>) {
+            archetype& owner = *match.owner;
+            size_t     count = owner.row_count(chunk);
+
+            fn(std::span<const entity>(owner.entities(chunk), count),
+               std::span<_Cs>(std::launder(reinterpret_cast<_Cs*>(owner.column_data(chunk, match.columns[_Is]))), count)...);
+        }
+
+    private:
+        world* m_world;
+
+        std::vector<_MyMatch>                             m_matches;
+        size_t                                            m_seen{ 0 };
+        std::vector<std::pair<const _MyMatch*, uint32_t>> m_tasks; // reused by parallel_each_chunk
+    };
+
+    // systems run in the order they were added, grouped into stages. A system joins the first stage
+    // after every earlier system it conflicts with : one writes a component the other reads or writes.
+    // The systems of a stage run in parallel on the executor, stages run one after another
+    class schedule {
+    public:
+        explicit schedule(world& target) : m_world(&target) {}
+        ~schedule() = default;
+
+        // fn(entity, _Cs&...) runs for every entity matching query<_Cs...>
+        template <typename... _Cs, typename _Fn>
+        void add(_Fn fn) {
+            auto system    = std::make_unique<_MySystemImpl<_Fn, _Cs...>>(*m_world, std::move(fn));
+            system->reads  = query<_Cs...>::reads();
+            system->writes = query<_Cs...>::writes();
+
+            size_t stage = 0;
+            for (const auto& earlier : m_systems) {
+                bool conflict = (system->writes & (earlier->reads | earlier->writes)).any() || (earlier->writes & system->reads).any();
+                if (conflict) stage = std::max(stage, earlier->stage + 1);
+            }
+            system->stage = stage;
+            m_stageCount  = std::max(m_stageCount, stage + 1);
+
+            m_systems.push_back(std::move(system));
+        }
+
+        // executor has the same contract as in query::parallel_each_chunk
+        template <typename _Executor>
+        void run(_Executor&& executor) {
+            std::vector<_MySystem*> stage_systems;
+            for (size_t stage = 0; stage < m_stageCount; stage++) {
+                stage_systems.clear();
+                for (const auto& system : m_systems) {
+                    if (system->stage == stage) stage_systems.push_back(system.get());
+                }
+
+                executor(stage_systems.size(), [&](size_t index) { stage_systems[index]->run(); });
+            }
+        }
+
+        size_t stage_count() const noexcept { return m_stageCount; }
+
+    private:
+        struct _MySystem {
+            component_mask reads;
+            component_mask writes;
+            size_t         stage = 0;
+
+            virtual ~_MySystem() = default;
+            virtual void run()   = 0;
+        };
+
+        template <typename _Fn, typename... _Cs>
+        struct _MySystemImpl : _MySystem {
+            query<_Cs...> target;
+            _Fn           fn;
+
+            _MySystemImpl(world& owner, _Fn&& fn) : target(owner), fn(std::move(fn)) {}
+            void run() override { target.each(fn); }
+        };
+
+    private:
+        world* m_world;
+
+        std::vector<std::unique_ptr<_MySystem>> m_systems;
+        size_t                                  m_stageCount{ 0 };
+    };
+
+} // namespace ata::ecs
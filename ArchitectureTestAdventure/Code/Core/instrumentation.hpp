@@ -0,0 +1,208 @@
+/*=================================================
+
+    Copyright (C) 2025 Farrakh. All Rights Reserved.
+
+    This file is a part of ArchitectureTestAdventure.
+    Check README.md for more information.
+
+    File : instrumentation.hpp
+
+    Content : operation and lock contention counters
+    for the ata storages. Compiled out by default.
+
+=================================================*/
+
+#pragma once
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <shared_mutex>
+#include <algorithm>
+
+// 1 : storages count their operations and lock waits. 0 : every counter and timer is compiled out,
+// storage_mutex is a plain std::shared_mutex and counters() returns zeros
+#ifndef ATA_STORAGE_INSTRUMENTATION
+#define ATA_STORAGE_INSTRUMENTATION 0
+#endif
+
+namespace ata {
+    constexpr bool STORAGE_INSTRUMENTATION_ENABLED = ATA_STORAGE_INSTRUMENTATION != 0;
+
+    // counter values of one storage or registry, read at one point in time
+    struct storage_counters {
+    public:
+        // bucket i holds waits in [ wait_bucket_floor(i), wait_bucket_floor(i + 1) ) nanoseconds, the last one is open
+        constexpr static size_t WAIT_BUCKETS = 20;
+
+        constexpr static uint64_t wait_bucket_floor(size_t bucket) noexcept { return bucket == 0 ? 0 : uint64_t(128) << (bucket - 1); }
+        constexpr static size_t   wait_bucket(uint64_t nanoseconds) noexcept { return std::min<size_t>(std::bit_width(nanoseconds >> 7), WAIT_BUCKETS - 1); }
+
+        uint64_t creates                = 0;
+        uint64_t destroys               = 0;
+        uint64_t gets                   = 0;
+        uint64_t failed_validations     = 0; // stale or null handles rejected by any lookup
+        uint64_t lock_acquisitions      = 0; // shared and exclusive
+        uint64_t contended_acquisitions = 0; // had to wait for another holder
+        uint64_t wait_nanoseconds       = 0; // total time spent in contended acquisitions
+
+        std::array<uint64_t, WAIT_BUCKETS> wait_histogram{};
+
+        storage_counters()  = default;
+        ~storage_counters() = default;
+    };
+
+#if ATA_STORAGE_INSTRUMENTATION
+
+    // relaxed counter spread over cache lines, so threads hammering the same storage
+    // do not bounce one line between them. Reads sum the shards
+    class sharded_counter {
+    public:
+        constexpr static size_t SHARDS = 16;
+
+        void add(uint64_t value = 1) noexcept {
+            m_shards[shard()].value.fetch_add(value, std::memory_order_relaxed);
+        }
+
+        uint64_t load() const noexcept {
+            uint64_t sum = 0;
+            for (const auto& shard : m_shards) sum += shard.value.load(std::memory_order_relaxed);
+            return sum;
+        }
+
+        void reset() noexcept {
+            for (auto& shard : m_shards) shard.value.store(0, std::memory_order_relaxed);
+        }
+
+    private:
+        static size_t shard() noexcept {
+            thread_local const size_t index = NEXT_SHARD.fetch_add(1, std::memory_order_relaxed) % SHARDS;
+            return index;
+        }
+
+        struct alignas(64) _MyShard {
+            std::atomic<uint64_t> value{ 0 };
+        };
+
+        std::array<_MyShard, SHARDS> m_shards{};
+
+        inline static std::atomic<size_t> NEXT_SHARD{ 0 };
+    };
+
+    // the per-operation counters a storage bumps through ATA_STORAGE_COUNT
+    struct storage_operation_counters {
+    public:
+        sharded_counter creates;
+        sharded_counter destroys;
+        sharded_counter gets;
+        sharded_counter failed_validations;
+
+        void read(storage_counters& out) const noexcept {
+            out.creates            = creates.load();
+            out.destroys           = destroys.load();
+            out.gets               = gets.load();
+            out.failed_validations = failed_validations.load();
+        }
+
+        void reset() noexcept {
+            creates.reset();
+            destroys.reset();
+            gets.reset();
+            failed_validations.reset();
+        }
+    };
+
+    // std::shared_mutex that counts its acquisitions. An acquisition first tries without blocking;
+    // only when that fails it is counted as contended and the blocking wait is timed
+    class instrumented_shared_mutex {
+    public:
+        instrumented_shared_mutex()  = default;
+        ~instrumented_shared_mutex() = default;
+
+        instrumented_shared_mutex(const instrumented_shared_mutex&)            = delete;
+        instrumented_shared_mutex& operator=(const instrumented_shared_mutex&) = delete;
+
+        void lock() {
+            m_acquisitions.add();
+            if (m_mutex.try_lock()) return;
+
+            auto start = std::chrono::steady_clock::now();
+            m_mutex.lock();
+            record_wait(start);
+        }
+
+        bool try_lock() {
+            bool locked = m_mutex.try_lock();
+            if (locked) m_acquisitions.add();
+            return locked;
+        }
+
+        void unlock() { m_mutex.unlock(); }
+
+        void lock_shared() {
+            m_acquisitions.add();
+            if (m_mutex.try_lock_shared()) return;
+
+            auto start = std::chrono::steady_clock::now();
+            m_mutex.lock_shared();
+            record_wait(start);
+        }
+
+        bool try_lock_shared() {
+            bool locked = m_mutex.try_lock_shared();
+            if (locked) m_acquisitions.add();
+            return locked;
+        }
+
+        void unlock_shared() { m_mutex.unlock_shared(); }
+
+        void read(storage_counters& out) const noexcept {
+            out.lock_acquisitions      = m_acquisitions.load();
+            out.contended_acquisitions = m_contended.load(std::memory_order_relaxed);
+            out.wait_nanoseconds       = m_waitNanoseconds.load(std::memory_order_relaxed);
+            for (size_t bucket = 0; bucket < storage_counters::WAIT_BUCKETS; bucket++) {
+                out.wait_histogram[bucket] = m_waitHistogram[bucket].load(std::memory_order_relaxed);
+            }
+        }
+
+        void reset() noexcept {
+            m_acquisitions.reset();
+            m_contended.store(0, std::memory_order_relaxed);
+            m_waitNanoseconds.store(0, std::memory_order_relaxed);
+            for (auto& bucket : m_waitHistogram) bucket.store(0, std::memory_order_relaxed);
+        }
+
+    private:
+        void record_wait(std::chrono::steady_clock::time_point start) noexcept {
+            uint64_t waited = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+
+            m_contended.fetch_add(1, std::memory_order_relaxed);
+            m_waitNanoseconds.fetch_add(waited, std::memory_order_relaxed);
+            m_waitHistogram[storage_counters::wait_bucket(waited)].fetch_add(1, std::memory_order_relaxed);
+        }
+
+    private:
+        std::shared_mutex m_mutex;
+
+        sharded_counter                                                   m_acquisitions;
+        std::atomic<uint64_t>                                             m_contended{ 0 };
+        std::atomic<uint64_t>                                             m_waitNanoseconds{ 0 };
+        std::array<std::atomic<uint64_t>, storage_counters::WAIT_BUCKETS> m_waitHistogram{};
+    };
+
+    using storage_mutex = instrumented_shared_mutex;
+
+#define ATA_STORAGE_COUNT(counter)          ((counter).add())
+#define ATA_STORAGE_COUNT_N(counter, count) ((counter).add(count))
+
+#else
+
+    using storage_mutex = std::shared_mutex;
+
+#define ATA_STORAGE_COUNT(counter)          ((void)0)
+#define ATA_STORAGE_COUNT_N(counter, count) ((void)0)
+
+#endif
+
+} // namespace ata
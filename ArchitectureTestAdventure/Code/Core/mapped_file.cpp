@@ -0,0 +1,132 @@
+/*=================================================
+
+    Copyright (C) 2025 Farrakh. All Rights Reserved.
+
+    This file is a part of ArchitectureTestAdventure.
+    Check README.md for more information.
+
+    File : mapped_file.cpp
+
+    Content : read-only memory-mapped view of a file
+
+=================================================*/
+
+#include "pch.hpp"
+#include "mapped_file.hpp"
+
+#include <utility>
+
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+ata::mapped_file::mapped_file(mapped_file&& other) noexcept {
+    *this = std::move(other);
+}
+
+ata::mapped_file& ata::mapped_file::operator=(mapped_file&& other) noexcept {
+    if (this == &other) return *this;
+    this->close();
+
+    m_data = std::exchange(other.m_data, nullptr);
+    m_size = std::exchange(other.m_size, 0);
+    m_open = std::exchange(other.m_open, false);
+#ifdef _WIN32
+    m_file    = std::exchange(other.m_file, nullptr);
+    m_mapping = std::exchange(other.m_mapping, nullptr);
+#endif
+    return *this;
+}
+
+#ifdef _WIN32
+
+bool ata::mapped_file::open(const std::filesystem::path& path) {
+    this->close();
+
+    HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return false;
+
+    LARGE_INTEGER size{};
+    if (!GetFileSizeEx(file, &size)) {
+        CloseHandle(file);
+        return false;
+    }
+
+    m_file = file;
+    m_open = true;
+    if (size.QuadPart == 0) return true; // an empty file can not be mapped
+
+    m_mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (m_mapping == nullptr) {
+        this->close();
+        return false;
+    }
+
+    m_data = static_cast<const std::byte*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+    if (m_data == nullptr) {
+        this->close();
+        return false;
+    }
+
+    m_size = static_cast<size_t>(size.QuadPart);
+    return true;
+}
+
+void ata::mapped_file::close() noexcept {
+    if (m_data != nullptr) UnmapViewOfFile(m_data);
+    if (m_mapping != nullptr) CloseHandle(m_mapping);
+    if (m_file != nullptr) CloseHandle(m_file);
+
+    m_data    = nullptr;
+    m_size    = 0;
+    m_open    = false;
+    m_file    = nullptr;
+    m_mapping = nullptr;
+}
+
+#else
+
+bool ata::mapped_file::open(const std::filesystem::path& path) {
+    this->close();
+
+    int file = ::open(path.c_str(), O_RDONLY);
+    if (file < 0) return false;
+
+    struct stat info {};
+    if (fstat(file, &info) != 0) {
+        ::close(file);
+        return false;
+    }
+
+    if (info.st_size > 0) {
+        void* data = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+        if (data == MAP_FAILED) {
+            ::close(file);
+            return false;
+        }
+
+        m_data = static_cast<const std::byte*>(data);
+        m_size = static_cast<size_t>(info.st_size);
+    }
+
+    ::close(file); // the mapping keeps its own reference to the file
+    m_open = true;
+    return true;
+}
+
+void ata::mapped_file::close() noexcept {
+    if (m_data != nullptr) munmap(const_cast<std::byte*>(m_data), m_size);
+
+    m_data = nullptr;
+    m_size = 0;
+    m_open = false;
+}
+
+#endif
@@ -0,0 +1,50 @@
+/*=================================================
+
+    Copyright (C) 2025 Farrakh. All Rights Reserved.
+
+    This file is a part of ArchitectureTestAdventure.
+    Check README.md for more information.
+
+    File : mapped_file.hpp
+
+    Content : read-only memory-mapped view of a file
+
+=================================================*/
+
+#pragma once
+#include <cstddef>
+#include <span>
+#include <filesystem>
+
+namespace ata {
+    // maps a whole file into memory for reading. Pages are loaded by the OS on first touch,
+    // so opening a big file costs almost nothing until its bytes are read
+    class mapped_file {
+    public:
+        mapped_file() = default;
+        ~mapped_file() { this->close(); }
+
+        mapped_file(const mapped_file&)            = delete;
+        mapped_file& operator=(const mapped_file&) = delete;
+
+        mapped_file(mapped_file&& other) noexcept;
+        mapped_file& operator=(mapped_file&& other) noexcept;
+
+        // false if the file can not be opened or mapped. An empty file opens with an empty view
+        bool open(const std::filesystem::path& path);
+        void close() noexcept;
+
+        bool                       is_open() const noexcept { return m_open; }
+        std::span<const std::byte> bytes() const noexcept { return { m_data, m_size }; }
+
+    private:
+        const std::byte* m_data = nullptr;
+        size_t           m_size = 0;
+        bool             m_open = false;
+
+#ifdef _WIN32
+        void* m_file    = nullptr;
+        void* m_mapping = nullptr;
+#endif
+    };
+} // namespace ata
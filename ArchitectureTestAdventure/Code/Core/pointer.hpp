@@ -18,13 +18,28 @@
 #include <cstdint>
 #include <cassert>
 #include <unordered_map>
-#include <typeindex>
+#include <array>
 #include <memory>
+#include <memory_resource>
 #include <shared_mutex>
+#include <mutex>
 #include <type_traits>
+#include <atomic>
+#include <algorithm>
+#include <limits>
+#include <bit>
+#include <utility>
+#include <span>
+#include <new>
+#include <cstddef>
+#include <cstring>
+#include <thread>
+#include <typeinfo>
+
+#include <instrumentation.hpp>
 
 namespace ata {
-    using handle_t = uint64_t; // can be replaced by uint32_t
+    using handle_t = uint64_t;
 
     template <typename _Ty>
     concept is_storable_v =
@@ -34,57 +49,1330 @@ namespace ata {
         (!std::is_abstract_v<_Ty>) &&
         (!std::is_array_v<_Ty>);
 
-    template <typename _Ty>
+    // what a storage does with a slot whose generation counter is exhausted
+    enum class generation_overflow : uint8_t {
+        retire, // the slot is never reused. Stale handles can not alias a new object
+        wrap    // the generation restarts from 0. The slot is reused, a very old stale handle may alias
+    };
+
+    // bit layout of a pointer : ( generation << index_bits ) | index, packed into the smallest
+    // unsigned integer that fits. The all-ones index is reserved for the null pointer
+    template <uint32_t _IndexBits, uint32_t _GenerationBits, generation_overflow _Overflow = generation_overflow::retire>
+    struct handle_encoding {
+        static_assert(_IndexBits > 0 && _GenerationBits > 0, "handle_encoding : both fields need at least one bit");
+        static_assert(_IndexBits + _GenerationBits <= 64, "handle_encoding : a handle does not fit into 64 bits");
+        // a slot state is ( generation << 1 ) | alive and a retired slot is ( MAX_GENERATION + 1 ) << 1
+        static_assert(_GenerationBits <= 62, "handle_encoding : slot states need two bits above the generation");
+
+        using value_type = std::conditional_t<(_IndexBits + _GenerationBits <= 32), uint32_t, uint64_t>;
+
+        constexpr static uint32_t            INDEX_BITS      = _IndexBits;
+        constexpr static uint32_t            GENERATION_BITS = _GenerationBits;
+        constexpr static generation_overflow OVERFLOW_POLICY = _Overflow;
+
+        constexpr static handle_t NULL_INDEX     = (handle_t(1) << _IndexBits) - 1;
+        constexpr static handle_t MAX_INDEX      = NULL_INDEX - 1;
+        constexpr static handle_t MAX_GENERATION = _GenerationBits == 64 ? ~handle_t(0) : (handle_t(1) << _GenerationBits) - 1;
+
+        constexpr static value_type pack(handle_t index, handle_t generation) noexcept {
+            return static_cast<value_type>((generation << _IndexBits) | (index & NULL_INDEX));
+        }
+
+        constexpr static handle_t index(value_type value) noexcept { return handle_t(value) & NULL_INDEX; }
+        constexpr static handle_t generation(value_type value) noexcept { return handle_t(value) >> _IndexBits; }
+
+        // generation a slot gets after 'generation' was destroyed, or nullopt if the slot must be retired
+        constexpr static std::optional<handle_t> next_generation(handle_t generation) noexcept {
+            if (generation < MAX_GENERATION) return generation + 1;
+            if constexpr (_Overflow == generation_overflow::wrap) return handle_t(0);
+            else return std::nullopt;
+        }
+    };
+
+    // 8 bytes. Behavior change : pointer<_Ty> used to carry a full 64-bit index and a 64-bit generation
+    // ( 16 bytes ). Both are 32 bits now, so a storage addresses at most 2^32 - 1 slots and a slot is
+    // retired after 2^32 destroys instead of being reused forever. index() and generation() still
+    // return handle_t, but never hold more than 32 bits. A 64-bit generation does not fit this layout
+    using default_handle_encoding = handle_encoding<32, 32>;
+    using compact_handle_encoding = handle_encoding<24, 8>;  // 4 bytes : 16M slots, 256 generations
+
+    template <typename _Ty, typename _Encoding = default_handle_encoding>
     class pointer {
     public:
+        using encoding_t = _Encoding;
+        using value_t    = typename _Encoding::value_type;
+
         constexpr pointer(handle_t index, handle_t generation) noexcept
-            : m_index(index), m_generation(generation) {}
+            : m_value(_Encoding::pack(index, generation)) {}
         ~pointer() = default;
 
         constexpr pointer() noexcept                = default;
         pointer(const pointer&) noexcept            = default;
         pointer& operator=(const pointer&) noexcept = default;
 
-        constexpr handle_t index() const noexcept { return m_index; }
-        constexpr handle_t generation() const noexcept { return m_generation; }
+        constexpr handle_t index() const noexcept { return _Encoding::index(m_value); }
+        constexpr handle_t generation() const noexcept { return _Encoding::generation(m_value); }
+
+        // the packed bits, e.g. for GPU-visible handle tables
+        constexpr value_t        raw() const noexcept { return m_value; }
+        constexpr static pointer from_raw(value_t value) noexcept {
+            pointer result;
+            result.m_value = value;
+            return result;
+        }
 
         constexpr bool operator==(const pointer&) const noexcept = default;
         constexpr bool operator!=(const pointer&) const noexcept = default;
 
     private:
-        handle_t m_index{ std::numeric_limits<handle_t>::max() };
-        handle_t m_generation{ 0 };
+        value_t m_value{ _Encoding::pack(_Encoding::NULL_INDEX, 0) };
+    };
 
-        template <is_storable_v>
-        friend class typed_pointer_storage;
+    // deleter for objects allocated from a std::pmr::memory_resource. It remembers the size and the
+    // alignment of the allocated type, so a pmr_unique_ptr<base> may own a derived object
+    struct pmr_deleter {
+    public:
+        std::pmr::memory_resource* resource  = nullptr;
+        size_t                     size      = 0;
+        size_t                     alignment = 0;
+
+        template <typename _Ty>
+        void operator()(_Ty* object) const {
+            object->~_Ty();
+            resource->deallocate(object, size, alignment);
+        }
     };
 
-    template <is_storable_v _Ty>
+    template <typename _Ty>
+    using pmr_unique_ptr = std::unique_ptr<_Ty, pmr_deleter>;
+
+    template <typename _Ty, typename... _Args>
+    pmr_unique_ptr<_Ty> make_pmr_unique(std::pmr::memory_resource* resource, _Args&&... args) {
+        void* memory = resource->allocate(sizeof(_Ty), alignof(_Ty));
+        try {
+            return pmr_unique_ptr<_Ty>(::new (memory) _Ty(std::forward<_Args>(args)...), pmr_deleter{ resource, sizeof(_Ty), alignof(_Ty) });
+        }
+        catch (...) {
+            resource->deallocate(memory, sizeof(_Ty), alignof(_Ty));
+            throw;
+        }
+    }
+
+    struct storage_stats {
+    public:
+        size_t live     = 0; // objects reachable through a valid handle
+        size_t dead     = 0; // used slots without a live object : free, reserved by thread caches, deferred or retired
+        size_t capacity = 0; // slots in allocated pages
+        size_t pages    = 0;
+
+        // share of used slots that are dead. Iteration and memory pay for them
+        float fragmentation() const noexcept { return live + dead == 0 ? 0.0f : float(dead) / float(live + dead); }
+
+        storage_stats()  = default;
+        ~storage_stats() = default;
+    };
+
+    // first bytes of a typed_pointer_storage snapshot. It is followed by 'page_count' pages, each one
+    // stored as its states, alive words and object bytes, exactly as they are laid out in memory, and
+    // then by 'free_count' free slot indices. Native byte order : the magic reads wrong on the other one
+    struct storage_snapshot_header {
+    public:
+        constexpr static uint32_t MAGIC   = 0x53415441; // "ATAS"
+        constexpr static uint32_t VERSION = 1;
+
+        uint32_t magic            = MAGIC;
+        uint32_t version          = VERSION;
+        uint32_t object_size      = 0;
+        uint32_t object_alignment = 0;
+        uint32_t index_bits       = 0;
+        uint32_t generation_bits  = 0;
+        uint64_t page_size        = 0;
+        uint64_t page_count       = 0;
+        uint64_t size             = 0; // used slots
+        uint64_t free_count       = 0;
+        uint64_t generation_floor = 0;
+    };
+
+    template <is_storable_v _Ty, typename _Encoding = default_handle_encoding>
     class typed_pointer_storage {
+        struct _MyVersion;
+        struct _MyFrozenPage;
+
+    public:
+        using pointer_t = pointer<_Ty, _Encoding>;
+
+        struct remap_entry {
+            pointer_t from;
+            pointer_t to;
+        };
+
+        // run of slots written or destroyed since the last for_each_dirty_range(). Never crosses a page,
+        // so the raw object bytes of the run, dead slots included, are contiguous : slot i of the run is
+        // at bytes[ i * sizeof(_Ty) ]. Meant to be copied as is into a GPU buffer indexed by slot. The
+        // bytes of a destroyed slot are stale, is_alive() tells them apart
+        struct dirty_range {
+            handle_t                   first;
+            handle_t                   count;
+            std::span<const std::byte> bytes;
+        };
+
+        // handles moved by compact(), sorted by the old index
+        class remap_table {
+        public:
+            remap_table() = default;
+            explicit remap_table(std::vector<remap_entry> entries) : m_entries(std::move(entries)) {}
+            ~remap_table() = default;
+
+            // the new handle of a moved object, or 'handle' itself if it was not moved
+            pointer_t apply(pointer_t handle) const noexcept {
+                auto it = std::lower_bound(m_entries.begin(), m_entries.end(), handle.index(), [](const remap_entry& entry, handle_t index) {
+                    return entry.from.index() < index;
+                });
+                return it != m_entries.end() && it->from == handle ? it->to : handle;
+            }
+
+            std::span<const remap_entry> entries() const noexcept { return m_entries; }
+            size_t                       size() const noexcept { return m_entries.size(); }
+            bool                         empty() const noexcept { return m_entries.empty(); }
+
+        private:
+            std::vector<remap_entry> m_entries;
+        };
+
+        // immutable copy of the storage as it was at one publish(). Holding a view pins that version :
+        // publish() reclaims it only after every view on it is gone. Reads take no lock and never wait
+        // for the writer. A view must not outlive its storage
+        class read_view {
+        public:
+            read_view() = default;
+            ~read_view() { this->release(); }
+
+            read_view(const read_view&)            = delete;
+            read_view& operator=(const read_view&) = delete;
+
+            read_view(read_view&& other) noexcept
+                : m_version(std::exchange(other.m_version, nullptr)), m_slot(std::exchange(other.m_slot, nullptr)) {}
+
+            read_view& operator=(read_view&& other) noexcept {
+                if (this == &other) return *this;
+                this->release();
+
+                m_version = std::exchange(other.m_version, nullptr);
+                m_slot    = std::exchange(other.m_slot, nullptr);
+                return *this;
+            }
+
+            const _Ty* get(pointer_t handle) const noexcept {
+                const _MyFrozenPage* page = find_page(handle);
+                return page != nullptr ? page->object(handle.index() & PAGE_MASK) : nullptr;
+            }
+
+            bool is_valid(pointer_t handle) const noexcept {
+                return find_page(handle) != nullptr;
+            }
+
+            // calls fn(pointer_t, const _Ty&) for every object alive in this version
+            template <typename _Fn>
+            void for_each(_Fn&& fn) const {
+                if (m_version == nullptr) return;
+
+                for (handle_t page_index = 0; page_index < m_version->pages.size(); page_index++) {
+                    const _MyFrozenPage& page = *m_version->pages[page_index];
+                    for (handle_t word = 0; word < PAGE_SIZE / 64; word++) {
+                        for (uint64_t bits = page.alive[word]; bits != 0; bits &= bits - 1) {
+                            handle_t offset = (word << 6) | static_cast<handle_t>(std::countr_zero(bits));
+                            fn(pointer_t((page_index << PAGE_SHIFT) | offset, page.states[offset] >> 1), *page.object(offset));
+                        }
+                    }
+                }
+            }
+
+            // 0 for a view taken before the first publish(), which sees no objects
+            uint64_t epoch() const noexcept { return m_version != nullptr ? m_version->epoch : 0; }
+            bool     empty() const noexcept { return m_version == nullptr; }
+
+        private:
+            friend class typed_pointer_storage;
+
+            read_view(const _MyVersion* version, std::atomic<uint64_t>* slot) noexcept : m_version(version), m_slot(slot) {}
+
+            void release() noexcept {
+                if (m_slot != nullptr) m_slot->store(0, std::memory_order_release);
+                m_version = nullptr;
+                m_slot    = nullptr;
+            }
+
+            const _MyFrozenPage* find_page(pointer_t handle) const noexcept {
+                handle_t page_index = handle.index() >> PAGE_SHIFT;
+                if (m_version == nullptr || page_index >= m_version->pages.size()) return nullptr;
+
+                const _MyFrozenPage* page = m_version->pages[page_index].get();
+                if (page->states[handle.index() & PAGE_MASK] != ((handle.generation() << 1) | ALIVE_BIT)) return nullptr;
+                return page;
+            }
+
+        private:
+            const _MyVersion*      m_version = nullptr;
+            std::atomic<uint64_t>* m_slot    = nullptr; // reader slot holding the pinned epoch
+        };
+
+        // every page, directory and bookkeeping array comes from 'resource'. With a
+        // std::pmr::monotonic_buffer_resource a whole storage is released at once with the arena
+        explicit typed_pointer_storage(std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+            : m_resource(resource), m_pages(resource), m_directories(resource), m_freeList(resource), m_threadCaches(resource), m_deferred(resource) {}
+
+        ~typed_pointer_storage() {
+            if constexpr (!std::is_trivially_destructible_v<_Ty>) {
+                for (auto& page : m_pages) {
+                    page->for_each_alive([&](handle_t offset) { page->object(offset)->~_Ty(); });
+                }
+                for (const auto& deferred : m_deferred) {
+                    page_at(deferred.index)->object(deferred.index & PAGE_MASK)->~_Ty();
+                }
+            }
+        }
+
+        std::pmr::memory_resource* resource() const noexcept { return m_resource; }
+
+        typed_pointer_storage(const typed_pointer_storage&)            = delete;
+        typed_pointer_storage& operator=(const typed_pointer_storage&) = delete;
+
+        pointer_t create(_Ty value) {
+            ATA_STORAGE_COUNT(m_counters.creates);
+            if (m_threadCacheCapacity != 0) return create_cached(std::move(value));
+
+            std::unique_lock lock(m_mutex);
+            return create_locked(std::move(value));
+        }
+
+        pointer_t create()
+            requires std::default_initializable<_Ty>
+        {
+            return create(_Ty{});
+        }
+
+        void destroy(pointer_t handle) {
+            ATA_STORAGE_COUNT(m_counters.destroys);
+            if (m_threadCacheCapacity != 0) return destroy_cached(handle);
+
+            std::unique_lock lock(m_mutex);
+            destroy_locked(handle);
+        }
+
+        // invalidates the handle immediately, but keeps the object alive until collect() is called with
+        // a frame >= retire_frame. Meant for objects the GPU may still be using in frames in flight
+        void destroy_deferred(pointer_t handle, uint64_t retire_frame) {
+            ATA_STORAGE_COUNT(m_counters.destroys);
+            std::unique_lock lock(m_mutex);
+
+            std::optional<bool> reusable = invalidate_slot(handle);
+            if (!reusable.has_value()) return;
+
+            m_deferred.push_back(_MyDeferred{ handle.index(), retire_frame, *reusable });
+        }
+
+        // destroys every deferred object whose retire frame is <= completed_frame
+        // and returns their slots to the free list
+        void collect(uint64_t completed_frame) {
+            std::unique_lock lock(m_mutex);
+
+            std::erase_if(m_deferred, [&](const _MyDeferred& deferred) {
+                if (deferred.retire_frame > completed_frame) return false;
+
+                page_at(deferred.index)->object(deferred.index & PAGE_MASK)->~_Ty();
+                finish_release_locked(deferred.index, deferred.reusable);
+                return true;
+            });
+        }
+
+        size_t deferred_count() const noexcept {
+            std::shared_lock lock(m_mutex);
+            return m_deferred.size();
+        }
+
+        // thread cache mode : every thread keeps up to 'capacity' reserved slot indices of its own and
+        // refills or drains them from the global free list in batches of capacity / 2. While the cache
+        // has room, create and destroy take no lock. 0 disables the mode ( default ).
+        // Must be set before the storage is used from several threads
+        void set_thread_cache_capacity(size_t capacity) noexcept {
+            m_threadCacheCapacity = capacity < 2 ? capacity * 2 : capacity;
+        }
+
+        // dirty tracking : create(), get_mut(), mark_dirty() and destroys set a bit per slot, which
+        // for_each_dirty_range() reports and clears. Off by default. Must be set before the storage is used
+        void set_dirty_tracking(bool enabled) noexcept {
+            m_dirtyTracking = enabled;
+        }
+
+        // returns the calling thread's reserved indices to the global free list.
+        // Worker threads should call it before they exit, otherwise their indices stay reserved
+        void flush_thread_cache() {
+            _MyThreadCache* cache = find_thread_cache();
+            if (cache == nullptr) return;
+
+            std::unique_lock lock(m_mutex);
+            drain_locked(*cache, cache->indices.size());
+        }
+
+        // creates values.size() objects under a single lock acquisition. Pages and the free list are
+        // grown once up front. out[i] receives the handle of values[i]
+        void create_n(std::span<_Ty> values, std::span<pointer_t> out) {
+            assert(out.size() >= values.size() && "typed_pointer_storage::create_n() : output span is too small");
+            ATA_STORAGE_COUNT_N(m_counters.creates, values.size());
+            std::unique_lock lock(m_mutex);
+
+            size_t fresh = values.size() > m_freeList.size() ? values.size() - m_freeList.size() : 0;
+            while (capacity_locked() < m_size + fresh) add_page_locked();
+
+            for (size_t i = 0; i < values.size(); i++) {
+                out[i] = create_locked(std::move(values[i]));
+            }
+        }
+
+        void create_n(std::span<pointer_t> out)
+            requires std::default_initializable<_Ty>
+        {
+            ATA_STORAGE_COUNT_N(m_counters.creates, out.size());
+            std::unique_lock lock(m_mutex);
+
+            size_t fresh = out.size() > m_freeList.size() ? out.size() - m_freeList.size() : 0;
+            while (capacity_locked() < m_size + fresh) add_page_locked();
+
+            for (auto& handle : out) handle = create_locked(_Ty{});
+        }
+
+        // destroys every valid handle under a single lock acquisition. Invalid handles are skipped
+        void destroy_n(std::span<const pointer_t> handles) {
+            ATA_STORAGE_COUNT_N(m_counters.destroys, handles.size());
+            std::unique_lock lock(m_mutex);
+
+            if (m_freeList.size() + handles.size() > m_freeList.capacity()) {
+                m_freeList.reserve(std::max(m_freeList.size() + handles.size(), m_freeList.capacity() * 2));
+            }
+            for (const auto& handle : handles) destroy_locked(handle);
+        }
+
+        // lock-free. out[i] receives get(handles[i]), nullptr for invalid handles
+        void get_n(std::span<const pointer_t> handles, std::span<_Ty*> out) noexcept {
+            assert(out.size() >= handles.size() && "typed_pointer_storage::get_n() : output span is too small");
+            for (size_t i = 0; i < handles.size(); i++) out[i] = get(handles[i]);
+        }
+
+        void get_n(std::span<const pointer_t> handles, std::span<const _Ty*> out) const noexcept {
+            assert(out.size() >= handles.size() && "typed_pointer_storage::get_n() : output span is too small");
+            for (size_t i = 0; i < handles.size(); i++) out[i] = get(handles[i]);
+        }
+
+        // lock-free. Objects never move, so the returned pointer stays valid until the object is destroyed
+        _Ty* get(pointer_t handle) noexcept {
+            ATA_STORAGE_COUNT(m_counters.gets);
+            _MyPage* page = find_page(handle);
+            return page != nullptr ? page->object(handle.index() & PAGE_MASK) : nullptr;
+        }
+
+        const _Ty* get(pointer_t handle) const noexcept {
+            ATA_STORAGE_COUNT(m_counters.gets);
+            const _MyPage* page = find_page(handle);
+            return page != nullptr ? page->object(handle.index() & PAGE_MASK) : nullptr;
+        }
+
+        // lock-free. Same as get(), but records the write for dirty tracking and publish()
+        _Ty* get_mut(pointer_t handle) noexcept {
+            ATA_STORAGE_COUNT(m_counters.gets);
+            _MyPage* page = find_page(handle);
+            if (page == nullptr) return nullptr;
+
+            handle_t offset = handle.index() & PAGE_MASK;
+            mark_written(*page, offset);
+            return page->object(offset);
+        }
+
+        // lock-free. For writes through a pointer that was taken with get()
+        void mark_dirty(pointer_t handle) noexcept {
+            _MyPage* page = find_page(handle);
+            if (page != nullptr) mark_written(*page, handle.index() & PAGE_MASK);
+        }
+
+        // lock-free. Touches only the generation array, never the object itself
+        bool is_valid(pointer_t handle) const noexcept {
+            return find_page(handle) != nullptr;
+        }
+
+        // lock-free. Whether the slot at 'index' holds an object, e.g. to tell the destroyed slots of a dirty_range apart
+        bool is_alive(handle_t index) const noexcept {
+            _MyDirectory* directory  = m_directory.load(std::memory_order_acquire);
+            handle_t      page_index = index >> PAGE_SHIFT;
+            _MyPage*      page       = directory != nullptr && page_index < directory->capacity ? directory->pages[page_index].load(std::memory_order_acquire) : nullptr;
+            return page != nullptr && (page->states[index & PAGE_MASK].load(std::memory_order_acquire) & ALIVE_BIT) != 0;
+        }
+
+        size_t live_count() const noexcept {
+            std::shared_lock lock(m_mutex);
+            return live_count_locked();
+        }
+
+        size_t capacity() const noexcept {
+            std::shared_lock lock(m_mutex);
+            return capacity_locked();
+        }
+
+        // slots whose generation ran out under generation_overflow::retire
+        size_t retired_count() const noexcept {
+            return m_retiredCount.load(std::memory_order_relaxed);
+        }
+
+        // operation and lock counters since construction or the last reset_counters().
+        // All zero unless ATA_STORAGE_INSTRUMENTATION is 1
+        storage_counters counters() const noexcept {
+            storage_counters result{};
+#if ATA_STORAGE_INSTRUMENTATION
+            m_counters.read(result);
+            m_mutex.read(result);
+#endif
+            return result;
+        }
+
+        void reset_counters() noexcept {
+#if ATA_STORAGE_INSTRUMENTATION
+            m_counters.reset();
+            m_mutex.reset();
+#endif
+        }
+
+        storage_stats stats() const noexcept {
+            std::shared_lock lock(m_mutex);
+
+            storage_stats result{};
+            result.live     = live_count_locked();
+            result.dead     = m_size - result.live;
+            result.capacity = capacity_locked();
+            result.pages    = m_pages.size();
+            return result;
+        }
+
+        // moves live objects from the back into free slots at the front, then releases the pages
+        // and free-list capacity behind the last used slot. Every moved object gets a new handle :
+        // the old one becomes stale and the returned table maps it to the new one.
+        // Stop-the-world : no lock-free reader may run concurrently and no pointer from get() survives.
+        // Slots reserved by thread caches, deferred or retired are left where they are
+        remap_table compact() {
+            std::unique_lock lock(m_mutex);
+
+            std::sort(m_freeList.begin(), m_freeList.end());
+
+            std::vector<remap_entry> moves;
+            std::vector<handle_t>    vacated;
+
+            handle_t source     = m_size;
+            size_t   hole_index = 0;
+            for (; hole_index < m_freeList.size(); hole_index++) {
+                handle_t hole = m_freeList[hole_index];
+
+                while (source > hole + 1 && !is_alive_locked(source - 1)) source--;
+                if (source <= hole + 1) break;
+
+                source--;
+                _MyPage& page = *m_pages[source >> PAGE_SHIFT];
+                pointer_t from(source, page.states[source & PAGE_MASK].load(std::memory_order_relaxed) >> 1);
+                pointer_t to = construct_at(hole, std::move(*page.object(source & PAGE_MASK)));
+
+                if (release_slot(from)) vacated.push_back(source);
+                moves.push_back(remap_entry{ from, to });
+            }
+
+            // the holes left over and the vacated sources are free. Anything at or past the
+            // first free slot of the tail can be cut off
+            std::pmr::vector<handle_t> free_slots(m_freeList.begin() + hole_index, m_freeList.end(), m_resource);
+            free_slots.insert(free_slots.end(), vacated.begin(), vacated.end());
+            std::sort(free_slots.begin(), free_slots.end());
+
+            handle_t new_size = m_size;
+            while (!free_slots.empty() && free_slots.back() == new_size - 1) {
+                free_slots.pop_back();
+                new_size--;
+            }
+
+            trim_locked(new_size);
+
+            m_freeList = std::move(free_slots);
+            m_freeList.shrink_to_fit();
+
+            std::sort(moves.begin(), moves.end(), [](const remap_entry& a, const remap_entry& b) { return a.from.index() < b.from.index(); });
+            return remap_table(std::move(moves));
+        }
+
+        // allocates pages up front, so the next 'count' creates do not allocate
+        void reserve(size_t count) {
+            std::unique_lock lock(m_mutex);
+            while (capacity_locked() < count) add_page_locked();
+        }
+
+        // writes every used slot into a storage_snapshot_header blob for restore(). Pages are copied
+        // as they are, so _Ty must be trivially copyable. Deferred slots and slots reserved by thread
+        // caches are saved as free : no thread may create or destroy through its thread cache meanwhile
+        std::vector<std::byte> snapshot() const
+            requires std::is_trivially_copyable_v<_Ty>
+        {
+            std::unique_lock lock(m_mutex);
+
+            // every dead slot with a usable generation, highest index first,
+            // so the restored storage hands out the lowest indices first
+            std::vector<handle_t> free_slots;
+            for (handle_t index = m_size; index-- > 0;) {
+                handle_t state = m_pages[index >> PAGE_SHIFT]->states[index & PAGE_MASK].load(std::memory_order_relaxed);
+                if ((state & ALIVE_BIT) == 0 && (state >> 1) <= _Encoding::MAX_GENERATION) free_slots.push_back(index);
+            }
+
+            storage_snapshot_header header{};
+            header.object_size      = sizeof(_Ty);
+            header.object_alignment = alignof(_Ty);
+            header.index_bits       = _Encoding::INDEX_BITS;
+            header.generation_bits  = _Encoding::GENERATION_BITS;
+            header.page_size        = PAGE_SIZE;
+            header.page_count       = (m_size + PAGE_SIZE - 1) >> PAGE_SHIFT;
+            header.size             = m_size;
+            header.free_count       = free_slots.size();
+            header.generation_floor = m_generationFloor;
+
+            std::vector<std::byte> blob(sizeof(header) + header.page_count * SNAPSHOT_PAGE_BYTES + free_slots.size() * sizeof(handle_t));
+            std::byte*             out = blob.data();
+
+            std::memcpy(out, &header, sizeof(header));
+            out += sizeof(header);
+
+            for (handle_t page_index = 0; page_index < header.page_count; page_index++) {
+                const _MyPage& page = *m_pages[page_index];
+                std::memcpy(out, static_cast<const void*>(page.states), sizeof(page.states));
+                std::memcpy(out + sizeof(page.states), static_cast<const void*>(page.alive), sizeof(page.alive));
+                std::memcpy(out + sizeof(page.states) + sizeof(page.alive), page.objects, sizeof(page.objects));
+                out += SNAPSHOT_PAGE_BYTES;
+            }
+
+            if (!free_slots.empty()) std::memcpy(out, free_slots.data(), free_slots.size() * sizeof(handle_t));
+            return blob;
+        }
+
+        // rebuilds a snapshot() in this storage, which must be empty and not in use by other threads.
+        // 'blob' is only read, so it can be a mapped_file view. Handles taken before the snapshot are
+        // valid again. Returns false and leaves the storage empty if the blob is truncated or was
+        // written for a different _Ty, encoding or page layout
+        bool restore(std::span<const std::byte> blob)
+            requires std::is_trivially_copyable_v<_Ty>
+        {
+            std::unique_lock lock(m_mutex);
+            assert(m_size == 0 && "typed_pointer_storage::restore() : the storage is not empty");
+
+            storage_snapshot_header header{};
+            if (blob.size() < sizeof(header)) return false;
+            std::memcpy(&header, blob.data(), sizeof(header));
+
+            if (header.magic != storage_snapshot_header::MAGIC || header.version != storage_snapshot_header::VERSION) return false;
+            if (header.object_size != sizeof(_Ty) || header.object_alignment != alignof(_Ty)) return false;
+            if (header.index_bits != _Encoding::INDEX_BITS || header.generation_bits != _Encoding::GENERATION_BITS) return false;
+            if (header.page_size != PAGE_SIZE) return false;
+            if (header.size > _Encoding::MAX_INDEX + 1 || header.page_count != (header.size + PAGE_SIZE - 1) >> PAGE_SHIFT) return false;
+            if (header.free_count > header.size) return false;
+            if (blob.size() != sizeof(header) + header.page_count * SNAPSHOT_PAGE_BYTES + header.free_count * sizeof(handle_t)) return false;
+
+            const std::byte* pages = blob.data() + sizeof(header);
+            const std::byte* free  = pages + header.page_count * SNAPSHOT_PAGE_BYTES;
+
+            // validated before anything is touched. Every slot is live, free or retired, and exactly as
+            // snapshot() writes them : alive bits agree with the states, slots past 'size' are untouched,
+            // free indices are unique dead slots with a usable generation and every such slot is free
+            std::pmr::vector<handle_t> free_slots(header.free_count, m_resource);
+            if (header.free_count != 0) std::memcpy(free_slots.data(), free, header.free_count * sizeof(handle_t));
+
+            std::vector<bool> is_free(header.size, false);
+            for (handle_t index : free_slots) {
+                if (index >= header.size || is_free[index]) return false;
+                is_free[index] = true;
+            }
+
+            uint64_t live    = 0;
+            uint64_t retired = 0;
+            for (handle_t page_index = 0; page_index < header.page_count; page_index++) {
+                const std::byte* states = pages + page_index * SNAPSHOT_PAGE_BYTES;
+                const std::byte* alive  = states + sizeof(_MyPage::states);
+
+                for (handle_t offset = 0; offset < PAGE_SIZE; offset++) {
+                    handle_t index = (page_index << PAGE_SHIFT) | offset;
+
+                    handle_t state;
+                    uint64_t bits;
+                    std::memcpy(&state, states + offset * sizeof(handle_t), sizeof(state));
+                    std::memcpy(&bits, alive + (offset >> 6) * sizeof(uint64_t), sizeof(bits));
+
+                    bool alive_bit = ((bits >> (offset & 63)) & 1) != 0;
+                    if (alive_bit != ((state & ALIVE_BIT) != 0)) return false;
+
+                    if (index >= header.size) {
+                        if (state != 0) return false;
+                    } else if (alive_bit) {
+                        if ((state >> 1) > _Encoding::MAX_GENERATION || is_free[index]) return false;
+                        live++;
+                    } else if ((state >> 1) <= _Encoding::MAX_GENERATION) {
+                        if (!is_free[index]) return false;
+                    } else {
+                        if ((state >> 1) != _Encoding::MAX_GENERATION + 1 || is_free[index]) return false;
+                        retired++;
+                    }
+                }
+            }
+            if (live + header.free_count + retired != header.size) return false;
+
+            while (m_pages.size() < header.page_count) add_page_locked();
+
+            for (handle_t page_index = 0; page_index < header.page_count; page_index++) {
+                _MyPage&         page = *m_pages[page_index];
+                const std::byte* in   = pages + page_index * SNAPSHOT_PAGE_BYTES;
+                std::memcpy(static_cast<void*>(page.states), in, sizeof(page.states));
+                std::memcpy(static_cast<void*>(page.alive), in + sizeof(page.states), sizeof(page.alive));
+                std::memcpy(page.objects, in + sizeof(page.states) + sizeof(page.alive), sizeof(page.objects));
+            }
+
+            // the restored objects were never uploaded
+            if (m_dirtyTracking) {
+                for (handle_t index = 0; index < header.size; index++) m_pages[index >> PAGE_SHIFT]->set_dirty(index & PAGE_MASK);
+            }
+
+            m_size            = header.size;
+            m_freeList        = std::move(free_slots);
+            m_generationFloor = header.generation_floor;
+            m_retiredCount.store(retired, std::memory_order_relaxed);
+            return true;
+        }
+
+        // freezes the objects into a new version for read() and reclaims the versions no view pins anymore.
+        // Pages not touched since the previous version are shared with it, so a frame that changed a
+        // few objects copies a few pages. Writes through a get() pointer must be reported with
+        // mark_dirty() to be picked up. Returns the epoch of the new version
+        uint64_t publish()
+            requires std::copy_constructible<_Ty>
+        {
+            std::unique_lock lock(m_mutex);
+
+            if (m_publishedOwner == nullptr) m_publishedOwner = make_pmr_unique<_MyPublished>(m_resource, m_resource);
+            _MyPublished&     published = *m_publishedOwner;
+            const _MyVersion* previous  = published.current.load(std::memory_order_relaxed);
+
+            auto version   = make_pmr_unique<_MyVersion>(m_resource, m_resource);
+            version->epoch = previous != nullptr ? previous->epoch + 1 : 1;
+
+            handle_t page_count = (m_size + PAGE_SIZE - 1) >> PAGE_SHIFT;
+            version->pages.reserve(page_count);
+            for (handle_t page_index = 0; page_index < page_count; page_index++) {
+                _MyPage& page    = *m_pages[page_index];
+                bool     touched = page.touched.exchange(false, std::memory_order_relaxed);
+
+                if (!touched && previous != nullptr && page_index < previous->pages.size()) {
+                    version->pages.push_back(previous->pages[page_index]);
+                    continue;
+                }
+
+                auto frozen = std::allocate_shared<_MyFrozenPage>(std::pmr::polymorphic_allocator<_MyFrozenPage>(m_resource));
+                frozen->copy_from(page);
+                version->pages.push_back(std::move(frozen));
+            }
+
+            const _MyVersion* current = published.versions.emplace_back(std::move(version)).get();
+            published.current.store(current, std::memory_order_seq_cst);
+            published.latest.store(current->epoch, std::memory_order_seq_cst);
+            m_published.store(&published, std::memory_order_release);
+
+            // a view pins an epoch no newer than the version it holds, so nothing older than the
+            // oldest pinned epoch can be reached anymore
+            uint64_t oldest = std::numeric_limits<uint64_t>::max();
+            for (const auto& reader : published.readers) {
+                uint64_t pinned = reader.epoch.load(std::memory_order_seq_cst);
+                if (pinned != 0) oldest = std::min(oldest, pinned);
+            }
+            std::erase_if(published.versions, [&](const pmr_unique_ptr<_MyVersion>& retired) {
+                return retired.get() != current && retired->epoch < oldest;
+            });
+
+            return current->epoch;
+        }
+
+        // pins the latest published version without taking the storage lock. Up to MAX_READERS views
+        // may be held at once; past that read() spins until one is released
+        read_view read() const {
+            _MyPublished* published = m_published.load(std::memory_order_acquire);
+            if (published == nullptr) return read_view{};
+
+            // the pin lands before 'current' is touched. publish() stores 'latest' after 'current', so
+            // the version loaded below is at least as new as the pinned epoch and can not be reclaimed
+            std::atomic<uint64_t>* slot    = published->claim_slot(published->latest.load(std::memory_order_seq_cst));
+            const _MyVersion*      version = published->current.load(std::memory_order_seq_cst);
+            return read_view(version, slot);
+        }
+
+        // calls fn(const dirty_range&) for every run of dirty slots in index order and clears them. Runs
+        // separated by at most 'max_gap' clean slots are merged into one, trading a few redundant bytes
+        // for fewer copies. Marks that race with the call are reported either now or by the next call
+        template <typename _Fn>
+        void for_each_dirty_range(_Fn&& fn, handle_t max_gap = 0) {
+            std::shared_lock lock(m_mutex);
+
+            for (handle_t page_index = 0; page_index < m_pages.size(); page_index++) {
+                _MyPage& page = *m_pages[page_index];
+
+                handle_t first = 0;
+                handle_t last  = 0; // one past the end of the open run
+                bool     open  = false;
+
+                auto emit = [&]() {
+                    const dirty_range range{ (page_index << PAGE_SHIFT) | first, last - first, { page.objects[first].bytes, (last - first) * sizeof(_MyObject) } };
+                    fn(range);
+                };
+
+                for (handle_t word = 0; word < PAGE_SIZE / 64; word++) {
+                    if (page.dirty[word].load(std::memory_order_relaxed) == 0) continue;
+
+                    uint64_t bits = page.dirty[word].exchange(0, std::memory_order_relaxed);
+                    while (bits != 0) {
+                        handle_t low = std::countr_zero(bits);
+                        handle_t run = std::countr_one(bits >> low);
+                        handle_t at  = (word << 6) | low;
+
+                        if (open && at - last <= max_gap) {
+                            last = at + run;
+                        }
+                        else {
+                            if (open) emit();
+                            first = at;
+                            last  = at + run;
+                            open  = true;
+                        }
+
+                        bits = low + run == 64 ? 0 : bits & (~uint64_t(0) << (low + run));
+                    }
+                }
+
+                if (open) emit();
+            }
+        }
+
+        void clear_dirty() noexcept {
+            std::shared_lock lock(m_mutex);
+
+            for (auto& page : m_pages) {
+                for (auto& word : page->dirty) word.store(0, std::memory_order_relaxed);
+            }
+        }
+
+        // calls fn(pointer_t, _Ty&) for every live object. Dead slots are skipped 64 at a time
+        // using the alive bits. create and destroy must not be called from fn
+        template <typename _Fn>
+        void for_each(_Fn&& fn) {
+            std::shared_lock lock(m_mutex);
+
+            for (handle_t page_index = 0; page_index < m_pages.size(); page_index++) {
+                _MyPage& page = *m_pages[page_index];
+                page.for_each_alive([&](handle_t offset) {
+                    handle_t generation = page.states[offset].load(std::memory_order_relaxed) >> 1;
+                    fn(pointer_t((page_index << PAGE_SHIFT) | offset, generation), *page.object(offset));
+                });
+            }
+        }
+
+        // same as for_each, but the slots are split into chunks that run on 'executor'.
+        // executor(chunk_count, task) must call task(i) once for every i in [0, chunk_count), on any
+        // threads, and return after all of them finished. Chunks are a power of two of at least 64
+        // slots, so they start on an alive-mask word and on a cache line of the object array, and two
+        // chunks never write to the same cache line. Lock-free readers may run concurrently
+        template <typename _Executor, typename _Fn>
+        void parallel_for_each(_Executor&& executor, _Fn&& fn, size_t chunk_slots = DEFAULT_CHUNK_SLOTS) {
+            std::shared_lock lock(m_mutex);
+
+            handle_t chunk       = std::clamp<handle_t>(std::bit_floor(std::max<size_t>(chunk_slots, 1)), 64, PAGE_SIZE);
+            handle_t chunk_count = (m_size + chunk - 1) / chunk;
+            if (chunk_count == 0) return;
+
+            executor(static_cast<size_t>(chunk_count), [&](size_t chunk_index) {
+                handle_t first = static_cast<handle_t>(chunk_index) * chunk;
+                _MyPage& page  = *m_pages[first >> PAGE_SHIFT];
+
+                handle_t page_base = first & ~PAGE_MASK;
+                page.for_each_alive(first & PAGE_MASK, chunk, [&](handle_t offset) {
+                    handle_t generation = page.states[offset].load(std::memory_order_relaxed) >> 1;
+                    fn(pointer_t(page_base | offset, generation), *page.object(offset));
+                });
+            });
+        }
+
+    private:
+        constexpr static handle_t ALIVE_BIT = 1;
+
+        struct _MyObject {
+            alignas(_Ty) std::byte bytes[sizeof(_Ty)];
+        };
+
+        // slots per page : a power of two close to 64 KiB, but never less than 64 slots
+        constexpr static handle_t PAGE_SIZE  = std::max<handle_t>(64, std::bit_floor(65536 / (sizeof(_MyObject) + sizeof(handle_t))));
+        constexpr static handle_t PAGE_SHIFT = std::countr_zero(PAGE_SIZE);
+        constexpr static handle_t PAGE_MASK  = PAGE_SIZE - 1;
+
+        // structure of arrays : handle validation reads 'states', liveness scans read 'alive',
+        // and neither pulls the objects into cache. Allocated once and never moved
+        struct _MyPage {
+            // ( generation << 1 ) | alive. A single word, so a reader validates a handle with one atomic load
+            std::atomic<handle_t> states[PAGE_SIZE]{};
+            // one bit per slot. Atomic because threads with their own cached indices may share a word
+            std::atomic<uint64_t> alive[PAGE_SIZE / 64]{};
+            // one bit per slot written since the last for_each_dirty_range(), if dirty tracking is on
+            std::atomic<uint64_t> dirty[PAGE_SIZE / 64]{};
+            // set by every write. publish() copies only the pages touched since the previous version
+            std::atomic<bool> touched{ true };
+            alignas(64) _MyObject objects[PAGE_SIZE];
+
+            _Ty*       object(handle_t offset) noexcept { return std::launder(reinterpret_cast<_Ty*>(objects[offset].bytes)); }
+            const _Ty* object(handle_t offset) const noexcept { return std::launder(reinterpret_cast<const _Ty*>(objects[offset].bytes)); }
+
+            void set_alive(handle_t offset, bool value) noexcept {
+                uint64_t bit = uint64_t(1) << (offset & 63);
+                if (value) alive[offset >> 6].fetch_or(bit, std::memory_order_relaxed);
+                else alive[offset >> 6].fetch_and(~bit, std::memory_order_relaxed);
+            }
+
+            void set_dirty(handle_t offset) noexcept {
+                dirty[offset >> 6].fetch_or(uint64_t(1) << (offset & 63), std::memory_order_relaxed);
+            }
+
+            // read first, so pages written every frame do not bounce the cache line between writers
+            void touch() noexcept {
+                if (!touched.load(std::memory_order_relaxed)) touched.store(true, std::memory_order_relaxed);
+            }
+
+            template <typename _Fn>
+            void for_each_alive(_Fn&& fn) const {
+                for_each_alive(0, PAGE_SIZE, fn);
+            }
+
+            // 'first' and 'count' are multiples of 64
+            template <typename _Fn>
+            void for_each_alive(handle_t first, handle_t count, _Fn&& fn) const {
+                for (handle_t word = first / 64; word < (first + count) / 64; word++) {
+                    for (uint64_t bits = alive[word].load(std::memory_order_relaxed); bits != 0; bits &= bits - 1) {
+                        fn((word << 6) | static_cast<handle_t>(std::countr_zero(bits)));
+                    }
+                }
+            }
+        };
+
+        // page directory read by lock-free readers. When it is full a bigger copy is published
+        // and the old one is retired : a reader may still be inside it. Retired directories hold
+        // only pointers and are released together with the storage
+        struct _MyDirectory {
+            std::pmr::vector<std::atomic<_MyPage*>> pages;
+            handle_t                                capacity;
+
+            _MyDirectory(handle_t capacity, std::pmr::memory_resource* resource)
+                : pages(capacity, resource), capacity(capacity) {}
+        };
+
+        // per-thread reserved indices. Only the owning thread touches 'indices';
+        // 'reserved' mirrors its size for live_count()
+        struct alignas(64) _MyThreadCache {
+            std::vector<handle_t> indices;
+            std::atomic<size_t>   reserved{ 0 };
+        };
+
+        // NULL_INDEX once every index the encoding can address is in use
+        handle_t acquire_index_locked() {
+            if (!m_freeList.empty()) {
+                handle_t index = m_freeList.back();
+                m_freeList.pop_back();
+                return index;
+            }
+
+            if (m_size > _Encoding::MAX_INDEX) return _Encoding::NULL_INDEX;
+
+            if (m_size == capacity_locked()) add_page_locked();
+            return m_size++;
+        }
+
+        void mark_written(_MyPage& page, handle_t offset) noexcept {
+            page.touch();
+            if (m_dirtyTracking) page.set_dirty(offset);
+        }
+
+        // the slot at 'index' must be owned by the caller : either under the unique lock or reserved by its thread cache
+        pointer_t construct_at(handle_t index, _Ty&& value) {
+            _MyPage& page   = *page_at(index);
+            handle_t offset = index & PAGE_MASK;
+            handle_t state  = page.states[offset].load(std::memory_order_relaxed);
+
+            ::new (static_cast<void*>(page.objects[offset].bytes)) _Ty(std::move(value));
+            page.set_alive(offset, true);
+            mark_written(page, offset);
+            page.states[offset].store(state | ALIVE_BIT, std::memory_order_release);
+
+            return pointer_t(index, state >> 1);
+        }
+
+        // makes the handle stale without destroying the object. Returns nullopt if it already was stale,
+        // otherwise whether the slot can be reused afterwards. The generation is bumped with a CAS, so
+        // lock-free readers stop matching the handle before anything else happens and two racing destroys
+        // cannot both win. A retired slot keeps a generation past MAX_GENERATION, which no handle can carry
+        std::optional<bool> invalidate_slot(pointer_t handle) {
+            _MyPage* page = find_page(handle);
+            if (page == nullptr) return std::nullopt;
+
+            std::optional<handle_t> next = _Encoding::next_generation(handle.generation());
+
+            handle_t offset   = handle.index() & PAGE_MASK;
+            handle_t expected = (handle.generation() << 1) | ALIVE_BIT;
+            handle_t desired  = next.has_value() ? *next << 1 : (_Encoding::MAX_GENERATION + 1) << 1;
+            if (!page->states[offset].compare_exchange_strong(expected, desired, std::memory_order_acq_rel)) return std::nullopt;
+
+            page->set_alive(offset, false);
+            mark_written(*page, offset); // a GPU table kept by slot index has to clear the entry
+            return next.has_value();
+        }
+
+        // invalidates and destroys. Returns true if the slot can be reused
+        bool release_slot(pointer_t handle) {
+            std::optional<bool> reusable = invalidate_slot(handle);
+            if (!reusable.has_value()) return false;
+
+            page_at(handle.index())->object(handle.index() & PAGE_MASK)->~_Ty();
+
+            if (!*reusable) m_retiredCount.fetch_add(1, std::memory_order_relaxed);
+            return *reusable;
+        }
+
+        void finish_release_locked(handle_t index, bool reusable) {
+            if (reusable) m_freeList.push_back(index);
+            else m_retiredCount.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        pointer_t create_locked(_Ty&& value) {
+            handle_t index = acquire_index_locked();
+            if (index == _Encoding::NULL_INDEX) {
+                assert(false && "typed_pointer_storage::create() : out of handle indices");
+                return pointer_t{};
+            }
+            return construct_at(index, std::move(value));
+        }
+
+        void destroy_locked(pointer_t handle) {
+            if (release_slot(handle)) m_freeList.push_back(handle.index());
+        }
+
+        pointer_t create_cached(_Ty&& value) {
+            _MyThreadCache& cache = thread_cache();
+
+            if (cache.indices.empty()) {
+                std::unique_lock lock(m_mutex);
+
+                size_t batch = m_threadCacheCapacity / 2;
+                while (capacity_locked() < m_size + batch - std::min(batch, m_freeList.size())) add_page_locked();
+                for (size_t i = 0; i < batch; i++) {
+                    handle_t index = acquire_index_locked();
+                    if (index == _Encoding::NULL_INDEX) break;
+                    cache.indices.push_back(index);
+                }
+
+                if (cache.indices.empty()) {
+                    assert(false && "typed_pointer_storage::create() : out of handle indices");
+                    return pointer_t{};
+                }
+            }
+
+            handle_t index = cache.indices.back();
+            cache.indices.pop_back();
+            cache.reserved.store(cache.indices.size(), std::memory_order_relaxed);
+
+            return construct_at(index, std::move(value));
+        }
+
+        void destroy_cached(pointer_t handle) {
+            if (!release_slot(handle)) return;
+
+            _MyThreadCache& cache = thread_cache();
+            cache.indices.push_back(handle.index());
+
+            if (cache.indices.size() >= m_threadCacheCapacity) {
+                std::unique_lock lock(m_mutex);
+                drain_locked(cache, m_threadCacheCapacity / 2);
+            }
+            cache.reserved.store(cache.indices.size(), std::memory_order_relaxed);
+        }
+
+        void drain_locked(_MyThreadCache& cache, size_t count) {
+            m_freeList.insert(m_freeList.end(), cache.indices.end() - count, cache.indices.end());
+            cache.indices.resize(cache.indices.size() - count);
+            cache.reserved.store(cache.indices.size(), std::memory_order_relaxed);
+        }
+
+        // thread-local map from storage id to that thread's cache. Ids are never reused,
+        // so entries left behind by destroyed storages are never looked up again
+        static auto& thread_cache_map() {
+            thread_local std::unordered_map<uint64_t, _MyThreadCache*> caches;
+            return caches;
+        }
+
+        _MyThreadCache* find_thread_cache() const {
+            auto& caches = thread_cache_map();
+            auto  it     = caches.find(m_id);
+            return it != caches.end() ? it->second : nullptr;
+        }
+
+        _MyThreadCache& thread_cache() {
+            thread_local uint64_t        last_id    = 0;
+            thread_local _MyThreadCache* last_cache = nullptr;
+            if (last_id == m_id) return *last_cache;
+
+            _MyThreadCache* cache = find_thread_cache();
+            if (cache == nullptr) {
+                std::unique_lock lock(m_mutex);
+                cache = m_threadCaches.emplace_back(make_pmr_unique<_MyThreadCache>(m_resource)).get();
+                cache->indices.reserve(m_threadCacheCapacity);
+                thread_cache_map().emplace(m_id, cache);
+            }
+
+            last_id    = m_id;
+            last_cache = cache;
+            return *cache;
+        }
+
+        const _MyPage* find_page(pointer_t handle) const noexcept {
+            _MyDirectory* directory = m_directory.load(std::memory_order_acquire);
+
+            handle_t page_index = handle.index() >> PAGE_SHIFT;
+            _MyPage* page       = directory != nullptr && page_index < directory->capacity ? directory->pages[page_index].load(std::memory_order_acquire) : nullptr;
+
+            if (page == nullptr || page->states[handle.index() & PAGE_MASK].load(std::memory_order_acquire) != ((handle.generation() << 1) | ALIVE_BIT)) {
+                ATA_STORAGE_COUNT(m_counters.failed_validations);
+                return nullptr;
+            }
+            return page;
+        }
+
+        _MyPage* find_page(pointer_t handle) noexcept {
+            return const_cast<_MyPage*>(std::as_const(*this).find_page(handle));
+        }
+
+        // lock-free lookup of an allocated page. m_pages itself may be reallocated by another thread
+        _MyPage* page_at(handle_t index) const noexcept {
+            return m_directory.load(std::memory_order_acquire)->pages[index >> PAGE_SHIFT].load(std::memory_order_acquire);
+        }
+
+        handle_t capacity_locked() const noexcept {
+            return static_cast<handle_t>(m_pages.size()) * PAGE_SIZE;
+        }
+
+        // thread caches reserve and release indices without the lock, the sum is clamped so a racing
+        // cache never makes it exceed the used slots
+        size_t live_count_locked() const noexcept {
+            size_t reserved = m_freeList.size() + m_deferred.size() + m_retiredCount.load(std::memory_order_relaxed);
+            for (const auto& cache : m_threadCaches) reserved += cache->reserved.load(std::memory_order_relaxed);
+            return m_size - std::min<size_t>(reserved, m_size);
+        }
+
+        bool is_alive_locked(handle_t index) const noexcept {
+            return (m_pages[index >> PAGE_SHIFT]->states[index & PAGE_MASK].load(std::memory_order_relaxed) & ALIVE_BIT) != 0;
+        }
+
+        // drops the slots at and past 'new_size' and every page that no longer holds a used slot.
+        // Pages added later start at a generation above anything the dropped slots handed out,
+        // so stale handles into them can not alias new objects
+        void trim_locked(handle_t new_size) {
+            handle_t floor = m_generationFloor;
+            for (handle_t index = new_size; index < m_size; index++) {
+                floor = std::max(floor, (m_pages[index >> PAGE_SHIFT]->states[index & PAGE_MASK].load(std::memory_order_relaxed) >> 1) + 1);
+            }
+            m_size = new_size;
+
+            // a floor past MAX_GENERATION would make the new slots unusable : keep the pages instead
+            if (floor > _Encoding::MAX_GENERATION && _Encoding::OVERFLOW_POLICY == generation_overflow::retire) return;
+            m_generationFloor = floor > _Encoding::MAX_GENERATION ? 0 : floor;
+
+            _MyDirectory* directory = m_directory.load(std::memory_order_relaxed);
+            size_t        needed    = (new_size + PAGE_SIZE - 1) >> PAGE_SHIFT;
+            for (size_t page_index = needed; page_index < m_pages.size(); page_index++) {
+                directory->pages[page_index].store(nullptr, std::memory_order_release);
+            }
+            m_pages.resize(needed);
+            m_pages.shrink_to_fit();
+        }
+
+        // O(1) : no live object is copied or moved
+        void add_page_locked() {
+            _MyDirectory* directory  = m_directory.load(std::memory_order_relaxed);
+            handle_t      page_index = static_cast<handle_t>(m_pages.size());
+
+            if (directory == nullptr || page_index == directory->capacity) {
+                auto grown = make_pmr_unique<_MyDirectory>(m_resource, std::max<handle_t>(MIN_DIRECTORY_CAPACITY, page_index * 2), m_resource);
+
+                for (handle_t i = 0; i < page_index; i++) {
+                    grown->pages[i].store(m_pages[i].get(), std::memory_order_relaxed);
+                }
+
+                directory = grown.get();
+                m_directory.store(directory, std::memory_order_release);
+                m_directories.push_back(std::move(grown));
+            }
+
+            auto page = make_pmr_unique<_MyPage>(m_resource);
+            if (m_generationFloor != 0) {
+                for (auto& state : page->states) state.store(m_generationFloor << 1, std::memory_order_relaxed);
+            }
+
+            m_pages.push_back(std::move(page));
+            directory->pages[page_index].store(m_pages.back().get(), std::memory_order_release);
+        }
+
+    private:
+        constexpr static handle_t MIN_DIRECTORY_CAPACITY = 16;
+        constexpr static size_t   DEFAULT_CHUNK_SLOTS    = 4096;
+        constexpr static size_t   MAX_READERS            = 64;
+
+        // a page as it was at one publish(). Shared by every version the page did not change in
+        struct _MyFrozenPage {
+            handle_t states[PAGE_SIZE]{};
+            uint64_t alive[PAGE_SIZE / 64]{};
+            alignas(64) _MyObject objects[PAGE_SIZE];
+
+            _MyFrozenPage() = default;
+            ~_MyFrozenPage() {
+                if constexpr (!std::is_trivially_destructible_v<_Ty>) {
+                    for (handle_t word = 0; word < PAGE_SIZE / 64; word++) {
+                        for (uint64_t bits = alive[word]; bits != 0; bits &= bits - 1) {
+                            std::launder(reinterpret_cast<_Ty*>(objects[(word << 6) | std::countr_zero(bits)].bytes))->~_Ty();
+                        }
+                    }
+                }
+            }
+
+            const _Ty* object(handle_t offset) const noexcept { return std::launder(reinterpret_cast<const _Ty*>(objects[offset].bytes)); }
+
+            // driven by the states, which a create publishes last : a slot is copied only once its object exists
+            void copy_from(const _MyPage& page) {
+                for (handle_t offset = 0; offset < PAGE_SIZE; offset++) {
+                    handle_t state = page.states[offset].load(std::memory_order_acquire);
+                    if ((state & ALIVE_BIT) != 0) {
+                        ::new (static_cast<void*>(objects[offset].bytes)) _Ty(*page.object(offset));
+                        alive[offset >> 6] |= uint64_t(1) << (offset & 63);
+                    }
+                    states[offset] = state;
+                }
+            }
+        };
+
+        struct _MyVersion {
+            uint64_t                                               epoch = 0;
+            std::pmr::vector<std::shared_ptr<const _MyFrozenPage>> pages;
+
+            explicit _MyVersion(std::pmr::memory_resource* resource) : pages(resource) {}
+        };
+
+        // pinned epoch of one read_view, 0 while free. One cache line each, so readers do not share lines
+        struct alignas(64) _MyReaderSlot {
+            std::atomic<uint64_t> epoch{ 0 };
+        };
+
+        struct _MyPublished {
+            std::atomic<const _MyVersion*>               current{ nullptr };
+            std::atomic<uint64_t>                        latest{ 0 }; // epoch of 'current', stored after it. What read() pins
+            std::array<_MyReaderSlot, MAX_READERS>       readers{};
+            std::pmr::vector<pmr_unique_ptr<_MyVersion>> versions; // the current one and the retired ones a view may still pin
+
+            explicit _MyPublished(std::pmr::memory_resource* resource) : versions(resource) {}
+
+            std::atomic<uint64_t>* claim_slot(uint64_t epoch) noexcept {
+                for (;;) {
+                    for (auto& reader : readers) {
+                        uint64_t expected = 0;
+                        if (reader.epoch.compare_exchange_strong(expected, epoch, std::memory_order_seq_cst)) return &reader.epoch;
+                    }
+                    std::this_thread::yield();
+                }
+            }
+        };
+
+        // states, alive words and objects of one page in a snapshot. The atomics are copied as raw
+        // words, which needs them to be plain lock-free integers
+        static_assert(sizeof(std::atomic<handle_t>) == sizeof(handle_t) && std::atomic<handle_t>::is_always_lock_free);
+        static_assert(sizeof(std::atomic<uint64_t>) == sizeof(uint64_t) && std::atomic<uint64_t>::is_always_lock_free);
+        constexpr static size_t SNAPSHOT_PAGE_BYTES = PAGE_SIZE * sizeof(handle_t) + PAGE_SIZE / 64 * sizeof(uint64_t) + PAGE_SIZE * sizeof(_MyObject);
+
+        std::pmr::memory_resource* m_resource;
+
+        std::pmr::vector<pmr_unique_ptr<_MyPage>>      m_pages;
+        std::atomic<_MyDirectory*>                     m_directory{ nullptr };
+        std::pmr::vector<pmr_unique_ptr<_MyDirectory>> m_directories; // current directory and the retired ones
+
+        handle_t                   m_size{ 0 };
+        std::pmr::vector<handle_t> m_freeList;
+        handle_t                   m_generationFloor{ 0 }; // first generation of slots in pages added after compact()
+
+        std::pmr::vector<pmr_unique_ptr<_MyThreadCache>> m_threadCaches;
+        size_t                                           m_threadCacheCapacity{ 0 };
+        bool                                             m_dirtyTracking{ false };
+        uint64_t                                         m_id{ NEXT_ID.fetch_add(1, std::memory_order_relaxed) };
+        std::atomic<size_t>                              m_retiredCount{ 0 };
+
+        struct _MyDeferred {
+            handle_t index;
+            uint64_t retire_frame;
+            bool     reusable;
+        };
+
+        std::pmr::vector<_MyDeferred> m_deferred;
+
+        pmr_unique_ptr<_MyPublished> m_publishedOwner;       // created by the first publish()
+        std::atomic<_MyPublished*>   m_published{ nullptr }; // set once the first version exists
+
+        inline static std::atomic<uint64_t> NEXT_ID{ 1 };
+
+#if ATA_STORAGE_INSTRUMENTATION
+        mutable storage_operation_counters m_counters;
+#endif
+        mutable storage_mutex m_mutex;
+    };
+
+    // sparse-set storage : live objects are kept contiguous in a dense array, and handles map into it
+    // through a sparse array. destroy swaps the last object into the hole, so iteration never meets a
+    // dead slot. Unlike typed_pointer_storage objects move : a pointer returned by get() is valid only
+    // until the next create or destroy
+    template <is_storable_v _Ty, typename _Encoding = default_handle_encoding>
+        requires std::is_move_assignable_v<_Ty>
+    class packed_pointer_storage {
     public:
-        using pointer_t = pointer<_Ty>;
+        using pointer_t = pointer<_Ty, _Encoding>;
 
-        typed_pointer_storage()  = default;
-        ~typed_pointer_storage() = default;
+        explicit packed_pointer_storage(std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+            : m_dense(resource), m_denseToSparse(resource), m_sparse(resource), m_freeList(resource) {}
+        ~packed_pointer_storage() = default;
+
+        packed_pointer_storage(const packed_pointer_storage&)            = delete;
+        packed_pointer_storage& operator=(const packed_pointer_storage&) = delete;
 
         pointer_t create(_Ty value) {
+            ATA_STORAGE_COUNT(m_counters.creates);
             std::unique_lock lock(m_mutex);
 
             handle_t index{};
             if (!m_freeList.empty()) {
                 index = m_freeList.back();
                 m_freeList.pop_back();
-
-                m_slots[index].object = std::move(value);
-                m_slots[index].alive  = true;
-                m_slots[index].generation++;
             }
             else {
-                index = static_cast<handle_t>(m_slots.size());
-
-                m_slots.emplace_back(_MySlot{ std::move(value) });
+                index = static_cast<handle_t>(m_sparse.size());
+                if (index > _Encoding::MAX_INDEX) {
+                    assert(false && "packed_pointer_storage::create() : out of handle indices");
+                    return pointer_t{};
+                }
+                m_sparse.emplace_back();
             }
-            return pointer_t(index, m_slots[index].generation);
+
+            m_sparse[index].dense = static_cast<handle_t>(m_dense.size());
+            m_dense.push_back(std::move(value));
+            m_denseToSparse.push_back(index);
+
+            return pointer_t(index, m_sparse[index].generation);
         }
 
         pointer_t create()
@@ -94,25 +1382,44 @@ namespace ata {
         }
 
         void destroy(pointer_t handle) {
+            ATA_STORAGE_COUNT(m_counters.destroys);
             std::unique_lock lock(m_mutex);
             if (!is_valid_locked(handle)) return;
 
-            m_slots[handle.m_index].object.~_Ty();
-            m_slots[handle.m_index].alive = false;
+            _MyEntry& entry = m_sparse[handle.index()];
+            handle_t  last  = static_cast<handle_t>(m_dense.size() - 1);
+
+            if (entry.dense != last) {
+                m_dense[entry.dense]         = std::move(m_dense[last]);
+                m_denseToSparse[entry.dense] = m_denseToSparse[last];
+
+                m_sparse[m_denseToSparse[last]].dense = entry.dense;
+            }
+
+            m_dense.pop_back();
+            m_denseToSparse.pop_back();
+
+            std::optional<handle_t> next = _Encoding::next_generation(entry.generation);
+
+            entry.dense      = INVALID_INDEX;
+            entry.generation = next.value_or(_Encoding::MAX_GENERATION);
 
-            m_freeList.push_back(handle.m_index);
+            // a retired entry stays dead forever : it is never put back to the free list
+            if (next.has_value()) m_freeList.push_back(handle.index());
         }
 
         _Ty* get(pointer_t handle) noexcept {
+            ATA_STORAGE_COUNT(m_counters.gets);
             std::shared_lock lock(m_mutex);
             if (!is_valid_locked(handle)) return nullptr;
-            return std::addressof(m_slots[handle.m_index].object);
+            return std::addressof(m_dense[m_sparse[handle.index()].dense]);
         }
 
         const _Ty* get(pointer_t handle) const noexcept {
+            ATA_STORAGE_COUNT(m_counters.gets);
             std::shared_lock lock(m_mutex);
             if (!is_valid_locked(handle)) return nullptr;
-            return std::addressof(m_slots[handle.m_index].object);
+            return std::addressof(m_dense[m_sparse[handle.index()].dense]);
         }
 
         bool is_valid(pointer_t handle) const noexcept {
@@ -122,68 +1429,178 @@ namespace ata {
 
         size_t live_count() const noexcept {
             std::shared_lock lock(m_mutex);
-            return m_slots.size() - m_freeList.size();
+            return m_dense.size();
+        }
+
+        // operation and lock counters since construction or the last reset_counters().
+        // All zero unless ATA_STORAGE_INSTRUMENTATION is 1
+        storage_counters counters() const noexcept {
+            storage_counters result{};
+#if ATA_STORAGE_INSTRUMENTATION
+            m_counters.read(result);
+            m_mutex.read(result);
+#endif
+            return result;
+        }
+
+        void reset_counters() noexcept {
+#if ATA_STORAGE_INSTRUMENTATION
+            m_counters.reset();
+            m_mutex.reset();
+#endif
+        }
+
+        // calls fn(pointer_t, _Ty&) for every live object, in dense order.
+        // create and destroy must not be called from fn
+        template <typename _Fn>
+        void for_each(_Fn&& fn) {
+            std::shared_lock lock(m_mutex);
+
+            for (size_t i = 0; i < m_dense.size(); i++) {
+                handle_t index = m_denseToSparse[i];
+                fn(pointer_t(index, m_sparse[index].generation), m_dense[i]);
+            }
         }
 
+        // the dense arrays. Not synchronized : the caller must make sure no create or destroy
+        // runs while the spans are in use. objects()[i] belongs to the slot indices()[i]
+        std::span<_Ty>            objects() noexcept { return m_dense; }
+        std::span<const _Ty>      objects() const noexcept { return m_dense; }
+        std::span<const handle_t> indices() const noexcept { return m_denseToSparse; }
+
     private:
         bool is_valid_locked(pointer_t handle) const noexcept {
-            if (handle.m_index >= m_slots.size()) return false;
-            if (!m_slots[handle.m_index].alive) return false;
-            return m_slots[handle.m_index].generation == handle.m_generation;
+            bool valid = handle.index() < m_sparse.size() && m_sparse[handle.index()].dense != INVALID_INDEX &&
+                         m_sparse[handle.index()].generation == handle.generation();
+            if (!valid) ATA_STORAGE_COUNT(m_counters.failed_validations);
+            return valid;
         }
 
-        struct _MySlot {
-            _Ty      object;
-            handle_t generation;
-            bool     alive;
+        constexpr static handle_t INVALID_INDEX = std::numeric_limits<handle_t>::max();
 
-            _MySlot(_Ty&& value, handle_t generation = 0, bool alive = true)
-                : object(std::move(value)), generation(generation), alive(alive) {}
-
-            _MySlot(const _Ty& value, handle_t generation = 0, bool alive = true)
-                : object(value), generation(generation), alive(alive) {}
+        struct _MyEntry {
+            handle_t dense      = INVALID_INDEX;
+            handle_t generation = 0;
         };
 
-        std::vector<_MySlot>  m_slots;
-        std::vector<handle_t> m_freeList;
+        std::pmr::vector<_Ty>      m_dense;
+        std::pmr::vector<handle_t> m_denseToSparse;
+        std::pmr::vector<_MyEntry> m_sparse;
+        std::pmr::vector<handle_t> m_freeList;
 
-        mutable std::shared_mutex m_mutex;
+#if ATA_STORAGE_INSTRUMENTATION
+        mutable storage_operation_counters m_counters;
+#endif
+        mutable storage_mutex m_mutex;
     };
 
     struct base_storage {
         virtual ~base_storage() = default;
+
+        virtual storage_counters counters() const noexcept  = 0;
+        virtual const char*      type_name() const noexcept = 0;
     };
 
-    template <is_storable_v _Ty>
+    template <is_storable_v _Ty, typename _Encoding>
     struct derived_storage : base_storage {
-        typed_pointer_storage<_Ty> storage;
+        typed_pointer_storage<_Ty, _Encoding> storage;
+
+        explicit derived_storage(std::pmr::memory_resource* resource) : storage(resource) {}
+
+        storage_counters counters() const noexcept override { return storage.counters(); }
+        const char*      type_name() const noexcept override { return typeid(_Ty).name(); }
+    };
+
+    // dense process-wide ids for storage types, assigned on first use
+    class storage_type_id {
+    public:
+        template <typename _Ty>
+        static size_t get() noexcept {
+            static const size_t id = NEXT_ID.fetch_add(1, std::memory_order_relaxed);
+            return id;
+        }
+
+    private:
+        inline static std::atomic<size_t> NEXT_ID{ 0 };
     };
 
     class pointer_storage {
     public:
-        pointer_storage()  = default;
+        constexpr static size_t MAX_STORAGE_TYPES = 1024;
+
+        // every typed storage created by this registry allocates from 'resource', e.g. a per-level arena
+        explicit pointer_storage(std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+            : m_resource(resource), m_overflow(resource), m_owned(resource) {}
         ~pointer_storage() = default;
 
-        template <is_storable_v _Ty>
-        typed_pointer_storage<_Ty>& get_storage() {
+        std::pmr::memory_resource* resource() const noexcept { return m_resource; }
+
+        // after the first call for a type this is one indexed atomic load : no lock, no hashing.
+        // Types past the first MAX_STORAGE_TYPES still work, through a hash map under the registry lock
+        template <is_storable_v _Ty, typename _Encoding = default_handle_encoding>
+        typed_pointer_storage<_Ty, _Encoding>& get_storage() {
+            size_t id = storage_type_id::get<typed_pointer_storage<_Ty, _Encoding>>();
+            if (id >= MAX_STORAGE_TYPES) return get_overflow_storage<_Ty, _Encoding>(id);
+
+            base_storage* storage = m_storages[id].load(std::memory_order_acquire);
+            if (storage != nullptr) {
+                return static_cast<derived_storage<_Ty, _Encoding>*>(storage)->storage;
+            }
+
             std::unique_lock lock(m_registryMutex);
 
-            std::type_index id = std::type_index(typeid(_Ty));
-            auto            it = m_storages.find(id);
-            if (it != m_storages.end()) {
-                return static_cast<derived_storage<_Ty>*>(it->second.get())->storage;
+            storage = m_storages[id].load(std::memory_order_relaxed);
+            if (storage == nullptr) {
+                storage = m_owned.emplace_back(make_pmr_unique<derived_storage<_Ty, _Encoding>>(m_resource, m_resource)).get();
+                m_storages[id].store(storage, std::memory_order_release);
+            }
+            return static_cast<derived_storage<_Ty, _Encoding>*>(storage)->storage;
+        }
+
+        // calls fn(const char* type_name, const storage_counters&) for every typed storage created so far
+        template <typename _Fn>
+        void for_each_counters(_Fn&& fn) const {
+            std::shared_lock lock(m_registryMutex);
+            for (const auto& storage : m_owned) fn(storage->type_name(), storage->counters());
+        }
+
+        // lock counters of the registry itself. All zero unless ATA_STORAGE_INSTRUMENTATION is 1
+        storage_counters registry_counters() const noexcept {
+            storage_counters result{};
+#if ATA_STORAGE_INSTRUMENTATION
+            m_registryMutex.read(result);
+#endif
+            return result;
+        }
+
+    private:
+        template <is_storable_v _Ty, typename _Encoding>
+        typed_pointer_storage<_Ty, _Encoding>& get_overflow_storage(size_t id) {
+            {
+                std::shared_lock lock(m_registryMutex);
+
+                auto it = m_overflow.find(id);
+                if (it != m_overflow.end()) return static_cast<derived_storage<_Ty, _Encoding>*>(it->second)->storage;
             }
 
-            auto  up  = std::make_unique<derived_storage<_Ty>>();
-            auto* ptr = &up->storage;
-            m_storages.emplace(id, std::move(up));
-            return *ptr;
+            std::unique_lock lock(m_registryMutex);
+
+            auto it = m_overflow.find(id);
+            if (it == m_overflow.end()) {
+                base_storage* storage = m_owned.emplace_back(make_pmr_unique<derived_storage<_Ty, _Encoding>>(m_resource, m_resource)).get();
+                it                    = m_overflow.emplace(id, storage).first;
+            }
+            return static_cast<derived_storage<_Ty, _Encoding>*>(it->second)->storage;
         }
 
     private:
-        std::unordered_map<std::type_index, std::unique_ptr<base_storage>> m_storages;
+        std::pmr::memory_resource* m_resource;
+
+        std::array<std::atomic<base_storage*>, MAX_STORAGE_TYPES> m_storages{};
+        std::pmr::unordered_map<size_t, base_storage*>            m_overflow; // type ids >= MAX_STORAGE_TYPES, under m_registryMutex
+        std::pmr::vector<pmr_unique_ptr<base_storage>>            m_owned;
 
-        mutable std::shared_mutex m_registryMutex;
+        mutable storage_mutex m_registryMutex;
     };
 
 } // namespace ata
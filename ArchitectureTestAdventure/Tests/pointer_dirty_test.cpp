@@ -0,0 +1,109 @@
+/*=================================================
+
+    Copyright (C) 2025 Farrakh. All Rights Reserved.
+
+    This file is a part of ArchitectureTestAdventure.
+    Check README.md for more information.
+
+    File : pointer_dirty_test.cpp
+
+    Content : dirty tracking of typed_pointer_storage.
+    Creates, writes and destroys have to show up in
+    the next for_each_dirty_range(). Standalone : build
+    with the Core directory on the include path, e.g.
+    g++ -std=c++20 -I../Code/Core pointer_dirty_test.cpp
+
+=================================================*/
+
+#include <pointer.hpp>
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+namespace {
+    struct object {
+        uint32_t value;
+    };
+
+    using storage_t = ata::typed_pointer_storage<object>;
+    using pointer_t = storage_t::pointer_t;
+
+    int failures = 0;
+
+    void check(bool condition, const char* what) {
+        if (condition) return;
+
+        std::printf("FAILED : %s\n", what);
+        failures++;
+    }
+
+    // every slot index reported by one for_each_dirty_range() call
+    std::vector<ata::handle_t> collect_dirty(storage_t& storage) {
+        std::vector<ata::handle_t> indices;
+        storage.for_each_dirty_range([&](const storage_t::dirty_range& range) {
+            for (ata::handle_t i = 0; i < range.count; i++) indices.push_back(range.first + i);
+        });
+        return indices;
+    }
+
+    bool contains(const std::vector<ata::handle_t>& indices, ata::handle_t index) {
+        for (ata::handle_t found : indices) {
+            if (found == index) return true;
+        }
+        return false;
+    }
+
+    void destroyed_slot_is_reported() {
+        storage_t storage;
+        storage.set_dirty_tracking(true);
+
+        pointer_t kept      = storage.create(object{ 1 });
+        pointer_t destroyed = storage.create(object{ 2 });
+        collect_dirty(storage); // the creates
+
+        storage.destroy(destroyed);
+
+        std::vector<ata::handle_t> dirty = collect_dirty(storage);
+        check(contains(dirty, destroyed.index()), "a destroyed slot shows up in the next dirty range");
+        check(!contains(dirty, kept.index()), "an untouched slot stays clean");
+        check(!storage.is_alive(destroyed.index()), "the destroyed slot reads as dead");
+        check(storage.is_alive(kept.index()), "the kept slot reads as alive");
+
+        check(collect_dirty(storage).empty(), "the range is reported once");
+    }
+
+    void destroy_n_slots_are_reported() {
+        storage_t storage;
+        storage.set_dirty_tracking(true);
+
+        std::vector<pointer_t> handles;
+        for (uint32_t i = 0; i < 8; i++) handles.push_back(storage.create(object{ i }));
+        collect_dirty(storage);
+
+        storage.destroy_n(std::span<const pointer_t>(handles.data(), 4));
+
+        std::vector<ata::handle_t> dirty = collect_dirty(storage);
+        for (size_t i = 0; i < handles.size(); i++) {
+            check(contains(dirty, handles[i].index()) == (i < 4), "destroy_n marks exactly the destroyed slots");
+        }
+    }
+
+    void no_marks_without_tracking() {
+        storage_t storage;
+
+        pointer_t handle = storage.create(object{ 1 });
+        storage.destroy(handle);
+
+        check(collect_dirty(storage).empty(), "nothing is reported while tracking is off");
+    }
+} // namespace
+
+int main() {
+    destroyed_slot_is_reported();
+    destroy_n_slots_are_reported();
+    no_marks_without_tracking();
+
+    if (failures == 0) std::puts("pointer_dirty_test : all passed");
+    return failures == 0 ? 0 : 1;
+}
@@ -140,7 +140,23 @@ namespace rhi {
     //                              Texture
     //////////////////////////////////////////////////////////////////////////
 
-    using TextureHandle = uint32_t;
+    // generation-checked handle of a texture owned by rhi::ResourceManager.
+    // Destroying a texture bumps the generation of its slot, so a handle kept past destroy
+    // is rejected instead of silently pointing at the next texture placed in that slot
+    struct TextureHandle {
+    public:
+        constexpr static uint32_t INVALID_INDEX = UINT32_MAX;
+
+        uint32_t index      = INVALID_INDEX;
+        uint32_t generation = 0; // slots start at generation 1, so 0 is never a live handle
+
+        constexpr bool isNull() const noexcept { return index == INVALID_INDEX; }
+
+        constexpr bool operator==(const TextureHandle&) const noexcept = default;
+
+        constexpr TextureHandle() = default;
+        constexpr TextureHandle(uint32_t _index, uint32_t _generation) : index(_index), generation(_generation) {}
+    };
 
     enum class TextureDimension : uint8_t {
         Unknown,
@@ -291,4 +307,113 @@ namespace rhi {
         ~Texture() = default;
     };
 
+    //////////////////////////////////////////////////////////////////////////
+    //                              Buffer
+    //////////////////////////////////////////////////////////////////////////
+
+    // generation-checked handle of a buffer owned by rhi::ResourceManager, see TextureHandle
+    struct BufferHandle {
+    public:
+        constexpr static uint32_t INVALID_INDEX = UINT32_MAX;
+
+        uint32_t index      = INVALID_INDEX;
+        uint32_t generation = 0;
+
+        constexpr bool isNull() const noexcept { return index == INVALID_INDEX; }
+
+        constexpr bool operator==(const BufferHandle&) const noexcept = default;
+
+        constexpr BufferHandle() = default;
+        constexpr BufferHandle(uint32_t _index, uint32_t _generation) : index(_index), generation(_generation) {}
+    };
+
+    enum class CpuAccessMode : uint8_t {
+        None,
+        Read, // readback heap
+        Write // upload heap
+    };
+
+    struct BufferDesc {
+    public:
+        uint64_t byte_size     = 0;
+        uint32_t struct_stride = 0; // if non-zero it's structured
+        Format   format        = Format::UNKNOWN; // for typed buffer views
+
+        bool can_have_uavs         = false;
+        bool can_have_typed_views  = false;
+        bool can_have_raw_views    = false;
+        bool is_vertex_buffer      = false;
+        bool is_index_buffer       = false;
+        bool is_constant_buffer    = false;
+        bool is_draw_indirect_args = false;
+
+        ResourceStates initial_state      = ResourceStates::Common;
+        bool           keep_initial_state = false; // see TextureDesc::keep_initial_state
+
+        CpuAccessMode       cpu_access            = CpuAccessMode::None;
+        SharedResourceFlags shared_resource_flags = SharedResourceFlags::None;
+
+        std::string debug_name;
+
+        // clang-format off
+        constexpr BufferDesc& setByteSize(uint64_t value) { byte_size = value; return *this; }
+        constexpr BufferDesc& setStructStride(uint32_t value) { struct_stride = value; return *this; }
+        constexpr BufferDesc& setFormat(Format value) { format = value; return *this; }
+        BufferDesc& setDebugName(const std::string& value) { debug_name = value; return *this; }
+        constexpr BufferDesc& setCanHaveUAVs(bool value) { can_have_uavs = value; return *this; }
+        constexpr BufferDesc& setCanHaveTypedViews(bool value) { can_have_typed_views = value; return *this; }
+        constexpr BufferDesc& setCanHaveRawViews(bool value) { can_have_raw_views = value; return *this; }
+        constexpr BufferDesc& setIsVertexBuffer(bool value) { is_vertex_buffer = value; return *this; }
+        constexpr BufferDesc& setIsIndexBuffer(bool value) { is_index_buffer = value; return *this; }
+        constexpr BufferDesc& setIsConstantBuffer(bool value) { is_constant_buffer = value; return *this; }
+        constexpr BufferDesc& setIsDrawIndirectArgs(bool value) { is_draw_indirect_args = value; return *this; }
+        constexpr BufferDesc& setInitialState(ResourceStates value) { initial_state = value; return *this; }
+        constexpr BufferDesc& setKeepInitialState(bool value) { keep_initial_state = value; return *this; }
+        constexpr BufferDesc& setCpuAccess(CpuAccessMode value) { cpu_access = value; return *this; }
+        constexpr BufferDesc& setSharedResourceFlags(SharedResourceFlags value) { shared_resource_flags = value; return *this; }
+        // clang-format on
+
+        // Equivalent to .setInitialState(_initial_state).setKeepInitialState(true)
+        constexpr BufferDesc& enableAutomaticStateTracking(ResourceStates initial_state) {
+            this->initial_state      = initial_state;
+            this->keep_initial_state = true;
+            return *this;
+        }
+
+        BufferDesc()  = default;
+        ~BufferDesc() = default;
+    };
+
+    // this is a GPU Buffer - POD resource, which is managed by rhi::ResourceManager
+    struct Buffer {
+    public:
+        // backend-private storage
+        void* backend_handle = nullptr;
+
+        uint64_t      byte_size;
+        CpuAccessMode cpu_access;
+
+        Buffer()  = default;
+        ~Buffer() = default;
+    };
+
+    struct MemoryRequirements {
+    public:
+        uint64_t size      = 0;
+        uint64_t alignment = 0;
+
+        MemoryRequirements()  = default;
+        ~MemoryRequirements() = default;
+    };
+
+    // device local memory, in bytes. usage is 0 when the backend cannot query it
+    struct MemoryBudget {
+    public:
+        uint64_t budget = 0; // what the process can use before the driver starts paging
+        uint64_t usage  = 0; // what the process uses, this ResourceManager and everything else
+
+        MemoryBudget()  = default;
+        ~MemoryBudget() = default;
+    };
+
 } // namespace rhi
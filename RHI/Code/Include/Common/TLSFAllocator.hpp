@@ -0,0 +1,91 @@
+/*=================================================
+
+    Copyright (C) 2025 Farrakh. All Rights Reserved.
+
+    This file is a part of ArchitectureTestAdventure.
+    Check README.md for more information.
+
+    File : TLSFAllocator.hpp
+
+    Content : two-level segregated fit allocator of ranges
+        inside an externally owned memory block
+
+=================================================*/
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "Attributes.hpp"
+
+namespace rhi {
+    // hands out offsets into a block it never touches, so the block can be GPU memory.
+    // Free ranges are kept in 2D size classes ( power of two, then SL_COUNT linear steps ) with a bitmap per level,
+    // which makes Allocate and Free O(1). Neighbouring free ranges are always merged
+    class TLSFAllocator {
+    public:
+        constexpr static uint32_t INVALID_NODE = UINT32_MAX;
+
+        struct Allocation {
+        public:
+            uint64_t offset = 0;
+            uint64_t size   = 0;
+            uint32_t node   = INVALID_NODE;
+
+            constexpr bool isValid() const noexcept { return node != INVALID_NODE; }
+        };
+
+    public:
+        TLSFAllocator() = default;
+        TLSFAllocator(uint64_t size);
+        ~TLSFAllocator() = default;
+
+        // alignment must be a power of two. Returns an invalid allocation when no free range is big enough
+        RHI_NODISCARD Allocation Allocate(uint64_t size, uint64_t alignment = 1);
+        void                     Free(const Allocation& allocation);
+
+        inline RHI_NODISCARD uint64_t getSize() const noexcept { return m_Size; }
+        inline RHI_NODISCARD uint64_t getUsedBytes() const noexcept { return m_UsedBytes; }
+        inline RHI_NODISCARD uint64_t getFreeBytes() const noexcept { return m_Size - m_UsedBytes; }
+        inline RHI_NODISCARD bool     isEmpty() const noexcept { return m_UsedBytes == 0; }
+
+    private:
+        constexpr static uint32_t SL_BITS  = 5;
+        constexpr static uint32_t SL_COUNT = 1u << SL_BITS;
+        constexpr static uint32_t FL_COUNT = 64 - SL_BITS + 1;
+
+        struct Node {
+        public:
+            uint64_t offset;
+            uint64_t size;
+            uint32_t prev_physical;
+            uint32_t next_physical;
+            uint32_t prev_free;
+            uint32_t next_free;
+            bool     free;
+        };
+
+    private:
+        static void mapping(uint64_t size, uint32_t& fl, uint32_t& sl) noexcept;
+
+        RHI_NODISCARD uint32_t findFree(uint64_t size) const noexcept;
+        void                   insertFree(uint32_t node);
+        void                   removeFree(uint32_t node);
+
+        RHI_NODISCARD uint32_t createNode();
+        void                   releaseNode(uint32_t node);
+
+    private:
+        uint64_t m_Size      = 0;
+        uint64_t m_UsedBytes = 0;
+
+        std::vector<Node>     m_Nodes;
+        std::vector<uint32_t> m_UnusedNodes;
+
+        uint64_t                                             m_FirstLevel = 0; // bit fl : m_SecondLevel[fl] != 0
+        std::array<uint32_t, FL_COUNT>                       m_SecondLevel{};  // bit sl : m_FreeHeads[fl][sl] is not empty
+        std::array<std::array<uint32_t, SL_COUNT>, FL_COUNT> m_FreeHeads{};
+    };
+} // namespace rhi
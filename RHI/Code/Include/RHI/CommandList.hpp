@@ -17,7 +17,6 @@
 #include "Swapchain.hpp"
 
 namespace rhi {
-    class Buffer;
     class Pipeline;
 
     class CommandList {
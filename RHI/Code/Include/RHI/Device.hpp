@@ -30,7 +30,38 @@ namespace rhi {
         virtual RHI_NODISCARD std::unique_ptr<rhi::Swapchain> CreateSwapchain()             = 0;
         virtual void                                          Submit(rhi::CommandList* cmd) = 0;
 
-        virtual RHI_NODISCARD void* CreateBackendTexture(const rhi::TextureDesc& desc) = 0;
-        virtual void                DestroyBackendTexture(void* backend_handle)        = 0;
+        // every Submit is one frame. getFrameNumber is the number the next Submit gets,
+        // every frame below getCompletedFrameNumber has finished executing on the GPU
+        virtual RHI_NODISCARD uint64_t getFrameNumber() const = 0;
+        virtual RHI_NODISCARD uint64_t getCompletedFrameNumber() = 0;
+        virtual void                   WaitForIdle()             = 0; // every submitted frame is complete afterwards
+
+        // CreateBackendTexture has to be safe to call from any thread, concurrently with every other call :
+        // rhi::ResourceManager creates async textures on a worker thread. It returns nullptr on failure
+        virtual RHI_NODISCARD void*    CreateBackendTexture(const rhi::TextureDesc& desc)   = 0;
+        virtual RHI_NODISCARD uint64_t getBackendTextureMemorySize(void* backend_handle) = 0;
+        virtual void                   DestroyBackendTexture(void* backend_handle)          = 0;
+
+        virtual RHI_NODISCARD rhi::MemoryBudget getMemoryBudget() = 0;
+
+        // large blocks of device memory that rhi::ResourceManager places small buffers into
+        virtual RHI_NODISCARD void* CreateBackendMemoryBlock(uint64_t size, rhi::CpuAccessMode cpu_access) = 0;
+        virtual void                DestroyBackendMemoryBlock(void* backend_block)                         = 0;
+
+        // placed : the buffer is created without memory, it is bound later with BindBackendBufferMemory
+        virtual RHI_NODISCARD void*                   CreateBackendBuffer(const rhi::BufferDesc& desc, bool placed)                       = 0;
+        virtual RHI_NODISCARD rhi::MemoryRequirements getBackendBufferMemoryRequirements(void* backend_handle)                            = 0;
+        virtual RHI_NODISCARD bool                    BindBackendBufferMemory(void* backend_handle, void* backend_block, uint64_t offset) = 0;
+        virtual void                                  DestroyBackendBuffer(void* backend_handle)                                          = 0;
+
+        // initial contents through the backend's staging path. The copies are submitted with the next Submit,
+        // which also makes them visible to its command list. The destination must not be in use by the GPU
+        virtual void UploadBackendBuffer(void* backend_handle, uint64_t offset, const void* data, uint64_t size)                                 = 0;
+        virtual void UploadBackendTexture(void* backend_handle, uint32_t mip_level, uint32_t array_slice, const void* data, uint64_t row_pitch) = 0;
+
+        // GPU-side copy of mip_count mips of every array slice, recorded for the next Submit on the graphics queue after
+        // its uploads and ahead of its command list. The source must hold shader-readable contents, like the upload path
+        // leaves them. The destination must not be in use by the GPU, it is shader-readable afterwards
+        virtual void CopyBackendTextureMips(void* destination, uint32_t destination_mip, void* source, uint32_t source_mip, uint32_t mip_count) = 0;
     };
 } // namespace rhi
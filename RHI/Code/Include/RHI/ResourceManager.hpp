@@ -14,35 +14,345 @@
 #pragma once
 
 #include <cassert>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
 #include <vector>
 
 #include "Common/Attributes.hpp"
 #include "Common/Resource.hpp"
+#include "Common/TLSFAllocator.hpp"
 
 #include "Device.hpp"
 
 namespace rhi {
     class ResourceManager {
+    public:
+        enum class TextureState : uint8_t {
+            Invalid, // null, stale or destroyed handle
+            Pending, // created by CreateTextureAsync, the backend texture is not there yet
+            Ready,
+            Evicted // dropped under memory pressure, RestoreTexture brings it back without contents
+        };
+
+        using TextureReadyCallback = std::function<void(TextureHandle)>;
+        using MipLoadCallback      = std::function<void(TextureHandle, uint32_t mip_level)>;
+
+        // buffers up to MAX_PLACED_BUFFER_SIZE share BUFFER_BLOCK_SIZE memory blocks, one set of blocks
+        // per CpuAccessMode. Bigger buffers get an allocation of their own
+        constexpr static uint64_t BUFFER_BLOCK_SIZE      = uint64_t(64) << 20;
+        constexpr static uint64_t MAX_PLACED_BUFFER_SIZE = BUFFER_BLOCK_SIZE / 4;
+
     public:
         ResourceManager() = default;
-        ~ResourceManager() { assert(m_Textures.empty() && "ResourceManager::Release() was not called"); }
+        ~ResourceManager() { assert(m_TextureCount == 0 && m_BufferCount == 0 && "ResourceManager::Release() was not called"); }
 
         ResourceManager(Device& device) : m_Device(device) {}
 
         void Release();
 
-        RHI_NODISCARD TextureHandle   CreateTexture(const rhi::TextureDesc& desc);
-        void                          DestroyTexture(TextureHandle handle);
-        inline RHI_NODISCARD Texture& getTexture(TextureHandle handle) { return m_Textures[handle]; }
+        // call once per frame, before the frame's resources are acquired.
+        // Destroys the backend textures and buffers whose last frame has completed on the GPU,
+        // streams mips in or out, and evicts textures when the device is over getBudgetUsageLimit() of its memory budget
+        void BeginFrame();
+
+        // DestroyTexture is O(1), stale handles are logged and ignored. The handle dies right away,
+        // the backend texture once the frames that may still use it are complete
+        RHI_NODISCARD TextureHandle CreateTexture(const rhi::TextureDesc& desc);
+        void                        DestroyTexture(TextureHandle handle);
+
+        // returns right away with a Pending handle, the backend texture is created on a worker thread.
+        // Finished textures are picked up by BeginFrame, getTextureState and FlushAsyncTextures, which is also
+        // where on_ready runs, on the calling thread. A texture destroyed while pending never calls on_ready.
+        // If the backend texture can not be created the error is logged, the handle turns Invalid and on_ready is not called
+        RHI_NODISCARD TextureHandle CreateTextureAsync(const rhi::TextureDesc& desc, TextureReadyCallback on_ready = {});
+        void                        FlushAsyncTextures(); // blocks until every async texture is Ready or has failed
+
+        // render targets and intermediates that live for a frame or two. Release parks the backend texture in a pool
+        // keyed by its desc, and Acquire with an equal desc reuses it once the frames that used it are complete.
+        // Textures not reused for getTransientTextureMaxAge() frames are destroyed by BeginFrame
+        RHI_NODISCARD TextureHandle AcquireTransientTexture(const rhi::TextureDesc& desc);
+        void                        ReleaseTransientTexture(TextureHandle handle);
+
+        // residency. Evictable textures not marked used for getEvictionMinAge() frames are evicted by BeginFrame
+        // when memory runs short, least recently used first. Pooled transient textures go before any of them.
+        // The handle stays valid, the owner reloads the contents after RestoreTexture
+        void MarkUsed(TextureHandle handle); // for every texture the frame being recorded reads
+        void setEvictable(TextureHandle handle, bool evictable);
+        void RestoreTexture(TextureHandle handle);
+
+        // mip streaming. desc describes the whole chain, but only the tail_mips coarsest mips are loaded at first
+        // ( the texture is Pending until they are ). BeginFrame loads up to the mip asked for with RequestStreamingMip
+        // while the budget has room, and drops fine mips of the coldest streaming textures before evicting anything.
+        // Loading finer mips creates a backend texture holding the new range of mips, copies the resident mips into it
+        // GPU-side and calls on_load for every new mip. The loader passes every array slice of that mip to UploadStreamingMip,
+        // right away or in a later frame, and the texture switches to the new backend texture once all of them are there.
+        // Dropping mips copies the kept ones into a smaller backend texture, which is used right away. Mip numbers are those of the whole
+        // chain, the backend texture starts at getStreamingMip(), so the renderer offsets its LOD by that
+        RHI_NODISCARD TextureHandle CreateStreamingTexture(const rhi::TextureDesc& desc, uint32_t tail_mips, MipLoadCallback on_load);
+        void                        RequestStreamingMip(TextureHandle handle, uint32_t mip_level);
+        void                        UploadStreamingMip(TextureHandle handle, uint32_t mip_level, uint32_t array_slice, const void* data, uint64_t row_pitch);
+        RHI_NODISCARD uint32_t      getStreamingMip(TextureHandle handle) const;
+
+        // backend_handle is nullptr while the texture is Pending or Evicted
+        inline RHI_NODISCARD Texture& getTexture(TextureHandle handle) {
+            assert(this->isValid(handle) && "stale or null TextureHandle");
+            return m_TextureSlots[handle.index].texture;
+        }
+
+        inline RHI_NODISCARD bool isValid(TextureHandle handle) const noexcept {
+            return handle.index < m_TextureSlots.size() && m_TextureSlots[handle.index].alive &&
+                   m_TextureSlots[handle.index].generation == handle.generation;
+        }
+
+        RHI_NODISCARD TextureState getTextureState(TextureHandle handle);
+
+        // staged through the device and submitted with the next Submit. Only for contents of resources
+        // the GPU is not using yet, data is copied before these return. row_pitch is in bytes, per row of blocks
+        void UploadTexture(TextureHandle handle, uint32_t mip_level, uint32_t array_slice, const void* data, uint64_t row_pitch);
+        void UploadBuffer(BufferHandle handle, uint64_t offset, const void* data, uint64_t size);
+
+        // DestroyBuffer defers like DestroyTexture, the buffer's block range is reused once its frame completes.
+        // CreateBuffer returns a null handle if the backend buffer can not be created
+        RHI_NODISCARD BufferHandle CreateBuffer(const rhi::BufferDesc& desc);
+        void                       DestroyBuffer(BufferHandle handle);
+
+        inline RHI_NODISCARD Buffer& getBuffer(BufferHandle handle) {
+            assert(this->isValid(handle) && "stale or null BufferHandle");
+            return m_BufferSlots[handle.index].buffer;
+        }
+
+        inline RHI_NODISCARD bool isValid(BufferHandle handle) const noexcept {
+            return handle.index < m_BufferSlots.size() && m_BufferSlots[handle.index].alive &&
+                   m_BufferSlots[handle.index].generation == handle.generation;
+        }
+
+        inline RHI_NODISCARD size_t   getTextureCount() const noexcept { return m_TextureCount; }
+        inline RHI_NODISCARD size_t   getPooledTextureCount() const noexcept { return m_PooledTextureCount; }
+        inline RHI_NODISCARD size_t   getRetiredTextureCount() const noexcept { return m_RetiredTextures.size(); }
+        inline RHI_NODISCARD size_t   getStreamingTextureCount() const noexcept { return m_StreamingTextures.size(); }
+        inline RHI_NODISCARD uint32_t getTransientTextureMaxAge() const noexcept { return m_TransientTextureMaxAge; }
+        inline RHI_NODISCARD size_t   getBufferCount() const noexcept { return m_BufferCount; }
+        inline RHI_NODISCARD size_t   getBufferBlockCount() const noexcept { return m_BufferBlockCount; }
+
+        // bytes of device memory. Textures count live and pooled backend textures, buffers count live buffers.
+        // Allocated is what this manager holds : textures, dedicated buffers and whole buffer blocks
+        inline RHI_NODISCARD uint64_t getTextureBytes() const noexcept { return m_TextureBytes; }
+        inline RHI_NODISCARD uint64_t getBufferBytes() const noexcept { return m_BufferBytes; }
+        inline RHI_NODISCARD uint64_t getAllocatedBytes() const noexcept { return m_TextureBytes + m_DedicatedBufferBytes + m_BufferBlockCount * BUFFER_BLOCK_SIZE; }
+
+        inline RHI_NODISCARD MemoryBudget getMemoryBudget() const noexcept { return m_MemoryBudget; } // as of the last BeginFrame
+        inline RHI_NODISCARD float        getBudgetUsageLimit() const noexcept { return m_BudgetUsageLimit; }
+        inline RHI_NODISCARD uint32_t     getEvictionMinAge() const noexcept { return m_EvictionMinAge; }
+
+        inline ResourceManager& setTransientTextureMaxAge(uint32_t frames) noexcept {
+            m_TransientTextureMaxAge = frames;
+            return *this;
+        }
+
+        // fraction of the budget BeginFrame evicts down to, 0 turns eviction off
+        inline ResourceManager& setBudgetUsageLimit(float fraction) noexcept {
+            m_BudgetUsageLimit = fraction;
+            return *this;
+        }
+
+        inline ResourceManager& setEvictionMinAge(uint32_t frames) noexcept {
+            m_EvictionMinAge = frames;
+            return *this;
+        }
 
         inline ResourceManager& setDevice(Device& device) noexcept {
             m_Device = device;
             return *this;
         }
 
+    private:
+        // slots are never erased, only recycled through m_FreeTextureSlots, so a handle keeps its index
+        // for the whole lifetime of the texture and destroy does not move other textures
+        struct TextureSlot {
+        public:
+            constexpr static uint32_t NOT_TRANSIENT = UINT32_MAX;
+
+            Texture          texture;
+            rhi::TextureDesc desc; // kept for RestoreTexture
+            uint64_t         byte_size        = 0;
+            uint64_t         last_used_frame  = 0;
+            uint32_t         generation       = 1;
+            uint32_t         transient_bucket = NOT_TRANSIENT; // index into m_TransientBuckets while acquired as transient
+            bool             alive            = false;
+            bool             pending          = false; // waiting for the async worker
+            bool             evictable        = false;
+            bool             evicted          = false;
+        };
+
+        // the TextureDesc fields that make two backend textures interchangeable, debug_name is left out
+        struct TransientTextureKey {
+        public:
+            uint32_t            width;
+            uint32_t            height;
+            uint32_t            depth;
+            uint32_t            array_size;
+            uint32_t            mip_levels;
+            uint32_t            sample_count;
+            uint32_t            sample_quality;
+            Format              format;
+            TextureDimension    dimension;
+            ResourceStates      initial_state;
+            SharedResourceFlags shared_resource_flags;
+            Color               clear_value;
+            uint32_t            flags; // the bool fields of TextureDesc, one bit each
+
+            TransientTextureKey(const rhi::TextureDesc& desc);
+            ~TransientTextureKey() = default;
+
+            bool operator==(const TransientTextureKey&) const = default;
+        };
+
+        struct TransientTextureKeyHash {
+            size_t operator()(const TransientTextureKey& key) const noexcept;
+        };
+
+        struct PooledTexture {
+        public:
+            void*    backend_handle;
+            uint64_t byte_size;
+            uint64_t last_used_frame; // reusable once the device has completed this frame
+        };
+
+        struct TransientBucket {
+        public:
+            std::vector<PooledTexture> pooled;
+        };
+
+        struct RetiredTexture {
+        public:
+            void*    backend_handle;
+            uint64_t byte_size;
+            uint64_t last_used_frame; // destroyed once the device has completed this frame
+        };
+
+        struct StreamingTexture {
+        public:
+            constexpr static uint32_t NOT_LOADING = UINT32_MAX;
+
+            MipLoadCallback   on_load;
+            uint32_t          tail_mip;      // finest mip of the tail, which never leaves
+            uint32_t          resident_mip;  // finest mip of the backend texture in the slot, mip_levels before the tail is loaded
+            uint32_t          requested_mip;
+            uint32_t          loading_mip    = NOT_LOADING; // finest mip of the backend texture being loaded
+            uint32_t          copied_mip     = 0; // mips from here on are copied from the resident texture, the loader brings the finer ones
+            void*             loading_handle = nullptr;
+            uint64_t          loading_bytes  = 0;
+            std::vector<bool> uploaded; // ( mip - loading_mip ) * array_size + array_slice, for mips below copied_mip
+            uint32_t          remaining = 0;
+        };
+
+        // same recycling scheme as TextureSlot
+        struct BufferSlot {
+        public:
+            constexpr static uint32_t DEDICATED = UINT32_MAX;
+
+            Buffer                    buffer;
+            TLSFAllocator::Allocation allocation;
+            uint64_t                  byte_size  = 0; // of its allocation, dedicated or placed
+            uint32_t                  generation = 1;
+            uint32_t                  block      = DEDICATED; // index into m_BufferBlocks of a placed buffer
+            bool                      alive      = false;
+        };
+
+        struct BufferBlock {
+        public:
+            void*         backend_block = nullptr; // nullptr once the block is destroyed, the entry is reused
+            CpuAccessMode cpu_access    = CpuAccessMode::None;
+            TLSFAllocator allocator;
+        };
+
+        struct RetiredBuffer {
+        public:
+            void*                     backend_handle;
+            uint32_t                  block;
+            TLSFAllocator::Allocation allocation;
+            uint64_t                  last_used_frame;
+        };
+
+        struct AsyncTextureJob {
+        public:
+            rhi::TextureDesc     desc;
+            TextureHandle        handle;
+            TextureReadyCallback on_ready;
+        };
+
+        struct AsyncTextureResult {
+        public:
+            TextureHandle        handle;
+            void*                backend_handle;
+            TextureReadyCallback on_ready;
+        };
+
+    private:
+        uint32_t allocateTextureSlot(const rhi::TextureDesc& desc, const Texture& texture);
+        void     freeTextureSlot(uint32_t index);
+
+        void enforceBudget();
+        void evictTexture(uint32_t index);
+
+        RHI_NODISCARD static rhi::TextureDesc getMipChainDesc(const rhi::TextureDesc& desc, uint32_t first_mip);
+
+        void                   growStreamingTextures(uint64_t headroom);
+        RHI_NODISCARD uint64_t shrinkStreamingTextures(uint64_t excess); // returns what is still in excess
+        RHI_NODISCARD bool     startStreamingLoad(uint32_t index, uint32_t first_mip); // false if the backend texture could not be created
+        void                   requestStreamingMips(const std::vector<TextureHandle>& handles);
+        void                   finishStreamingLoad(uint32_t index);
+
+        RHI_NODISCARD bool allocateBufferMemory(const MemoryRequirements& requirements, CpuAccessMode cpu_access, uint32_t& block, TLSFAllocator::Allocation& allocation);
+        void               freeBufferMemory(uint32_t block, const TLSFAllocator::Allocation& allocation);
+
+        void collectAsyncTextures();
+        void collectRetiredResources();
+        void asyncWorker(std::stop_token stop);
+
     private:
         Device& m_Device;
 
-        std::vector<Texture> m_Textures;
+        std::vector<TextureSlot> m_TextureSlots;
+        std::vector<uint32_t>    m_FreeTextureSlots;
+        size_t                   m_TextureCount = 0;
+
+        std::unordered_map<TransientTextureKey, uint32_t, TransientTextureKeyHash> m_TransientBucketIndices;
+        std::vector<TransientBucket>                                               m_TransientBuckets;
+        size_t                                                                     m_PooledTextureCount     = 0;
+        uint32_t                                                                   m_TransientTextureMaxAge = 8;
+
+        std::vector<BufferSlot>  m_BufferSlots;
+        std::vector<uint32_t>    m_FreeBufferSlots;
+        size_t                   m_BufferCount = 0;
+        std::vector<BufferBlock> m_BufferBlocks;
+        size_t                   m_BufferBlockCount = 0;
+
+        uint64_t     m_TextureBytes         = 0;
+        uint64_t     m_BufferBytes          = 0;
+        uint64_t     m_DedicatedBufferBytes = 0;
+        uint64_t     m_RetiredTextureBytes  = 0; // still allocated, but already gone from m_TextureBytes
+        MemoryBudget m_MemoryBudget;
+        float        m_BudgetUsageLimit = 0.9f;
+        uint32_t     m_EvictionMinAge   = 4;
+
+        std::unordered_map<uint32_t, StreamingTexture> m_StreamingTextures; // by slot index
+
+        // in destroy order, so also in last_used_frame order
+        std::deque<RetiredTexture> m_RetiredTextures;
+        std::deque<RetiredBuffer>  m_RetiredBuffers;
+
+        // the worker only touches these under m_AsyncMutex, the slots stay main-thread only
+        std::mutex                      m_AsyncMutex;
+        std::condition_variable_any     m_AsyncCondition;
+        std::deque<AsyncTextureJob>     m_AsyncJobs;
+        std::vector<AsyncTextureResult> m_AsyncResults;
+        size_t                          m_AsyncInFlight = 0; // queued or being created
+
+        std::jthread m_AsyncWorker; // last, so it is joined before the members it uses are destroyed
     };
 } // namespace rhi
@@ -157,6 +157,16 @@ namespace rhi {
     }
     // clang-format on
 
+    // clang-format off
+    nvrhi::CpuAccessMode to_nvrhi(rhi::CpuAccessMode mode) {
+        switch (mode) {
+            case rhi::CpuAccessMode::Read: return nvrhi::CpuAccessMode::Read;
+            case rhi::CpuAccessMode::Write: return nvrhi::CpuAccessMode::Write;
+            default: return nvrhi::CpuAccessMode::None;
+        }
+    }
+    // clang-format on
+
     nvrhi::TextureDesc to_nvrhi(const rhi::TextureDesc& desc) {
         nvrhi::TextureDesc d{};
         d.setWidth(desc.width);
@@ -180,4 +190,24 @@ namespace rhi {
         d.setSharedResourceFlags(rhi::to_nvrhi(desc.shared_resource_flags));
         return d;
     }
+
+    nvrhi::BufferDesc to_nvrhi(const rhi::BufferDesc& desc) {
+        nvrhi::BufferDesc d{};
+        d.setByteSize(desc.byte_size);
+        d.setStructStride(desc.struct_stride);
+        d.setFormat(rhi::to_nvrhi(desc.format));
+        d.setDebugName(desc.debug_name);
+        d.setCanHaveUAVs(desc.can_have_uavs);
+        d.setCanHaveTypedViews(desc.can_have_typed_views);
+        d.setCanHaveRawViews(desc.can_have_raw_views);
+        d.setIsVertexBuffer(desc.is_vertex_buffer);
+        d.setIsIndexBuffer(desc.is_index_buffer);
+        d.setIsConstantBuffer(desc.is_constant_buffer);
+        d.setIsDrawIndirectArgs(desc.is_draw_indirect_args);
+        d.setInitialState(rhi::to_nvrhi(desc.initial_state));
+        d.setKeepInitialState(desc.keep_initial_state);
+        d.setCpuAccess(rhi::to_nvrhi(desc.cpu_access));
+        d.sharedResourceFlags = rhi::to_nvrhi(desc.shared_resource_flags);
+        return d;
+    }
 } // namespace rhi
@@ -0,0 +1,198 @@
+/*=================================================
+
+    Copyright (C) 2025 Farrakh. All Rights Reserved.
+
+    This file is a part of ArchitectureTestAdventure.
+    Check README.md for more information.
+
+    File : TLSFAllocator.cpp
+
+    Content : two-level segregated fit allocator of ranges
+        inside an externally owned memory block
+
+=================================================*/
+
+#include "Common/TLSFAllocator.hpp"
+
+#include <bit>
+#include <cassert>
+
+rhi::TLSFAllocator::TLSFAllocator(uint64_t size) : m_Size(size) {
+    for (auto& heads : m_FreeHeads)
+        heads.fill(INVALID_NODE);
+
+    if (size == 0) return;
+
+    uint32_t node = this->createNode();
+    m_Nodes[node] = Node{ 0, size, INVALID_NODE, INVALID_NODE, INVALID_NODE, INVALID_NODE, true };
+    this->insertFree(node);
+}
+
+RHI_NODISCARD rhi::TLSFAllocator::Allocation rhi::TLSFAllocator::Allocate(uint64_t size, uint64_t alignment) {
+    assert(std::has_single_bit(alignment) && "alignment must be a power of two");
+    if (size == 0 || size > m_Size) return {};
+
+    // any free range of at least size + alignment - 1 fits once its start is aligned
+    uint32_t index = this->findFree(size + alignment - 1);
+    if (index == INVALID_NODE) return {};
+
+    this->removeFree(index);
+
+    // the front padding goes back as a free range of its own
+    uint64_t aligned = (m_Nodes[index].offset + alignment - 1) & ~(alignment - 1);
+    uint64_t padding = aligned - m_Nodes[index].offset;
+    if (padding > 0) {
+        uint32_t front = this->createNode();
+        auto&    node  = m_Nodes[index];
+
+        m_Nodes[front] = Node{ node.offset, padding, node.prev_physical, index, INVALID_NODE, INVALID_NODE, true };
+        if (node.prev_physical != INVALID_NODE) m_Nodes[node.prev_physical].next_physical = front;
+
+        node.prev_physical = front;
+        node.offset        = aligned;
+        node.size -= padding;
+        this->insertFree(front);
+    }
+
+    // and so does the tail
+    if (m_Nodes[index].size > size) {
+        uint32_t tail = this->createNode();
+        auto&    node = m_Nodes[index];
+
+        m_Nodes[tail] = Node{ node.offset + size, node.size - size, index, node.next_physical, INVALID_NODE, INVALID_NODE, true };
+        if (node.next_physical != INVALID_NODE) m_Nodes[node.next_physical].prev_physical = tail;
+
+        node.next_physical = tail;
+        node.size          = size;
+        this->insertFree(tail);
+    }
+
+    auto& node = m_Nodes[index];
+    node.free  = false;
+    m_UsedBytes += node.size;
+
+    return Allocation{ node.offset, node.size, index };
+}
+
+void rhi::TLSFAllocator::Free(const Allocation& allocation) {
+    if (!allocation.isValid()) return;
+
+    uint32_t index = allocation.node;
+    assert(index < m_Nodes.size() && !m_Nodes[index].free && "double free");
+
+    m_UsedBytes -= m_Nodes[index].size;
+    m_Nodes[index].free = true;
+
+    // merge with the free neighbours, keeping the lower node
+    uint32_t prev = m_Nodes[index].prev_physical;
+    if (prev != INVALID_NODE && m_Nodes[prev].free) {
+        this->removeFree(prev);
+
+        m_Nodes[prev].size += m_Nodes[index].size;
+        m_Nodes[prev].next_physical = m_Nodes[index].next_physical;
+        if (m_Nodes[index].next_physical != INVALID_NODE) m_Nodes[m_Nodes[index].next_physical].prev_physical = prev;
+
+        this->releaseNode(index);
+        index = prev;
+    }
+
+    uint32_t next = m_Nodes[index].next_physical;
+    if (next != INVALID_NODE && m_Nodes[next].free) {
+        this->removeFree(next);
+
+        m_Nodes[index].size += m_Nodes[next].size;
+        m_Nodes[index].next_physical = m_Nodes[next].next_physical;
+        if (m_Nodes[next].next_physical != INVALID_NODE) m_Nodes[m_Nodes[next].next_physical].prev_physical = index;
+
+        this->releaseNode(next);
+    }
+
+    this->insertFree(index);
+}
+
+void rhi::TLSFAllocator::mapping(uint64_t size, uint32_t& fl, uint32_t& sl) noexcept {
+    if (size < SL_COUNT) {
+        fl = 0;
+        sl = static_cast<uint32_t>(size);
+        return;
+    }
+
+    uint32_t msb = static_cast<uint32_t>(std::bit_width(size)) - 1;
+    fl           = msb - SL_BITS + 1;
+    sl           = static_cast<uint32_t>(size >> (msb - SL_BITS)) - SL_COUNT;
+}
+
+RHI_NODISCARD uint32_t rhi::TLSFAllocator::findFree(uint64_t size) const noexcept {
+    // round up to the next size class, so every range of the class found below is big enough
+    if (size >= SL_COUNT) {
+        uint32_t msb  = static_cast<uint32_t>(std::bit_width(size)) - 1;
+        uint64_t step = (uint64_t(1) << (msb - SL_BITS)) - 1;
+        if (size > UINT64_MAX - step) return INVALID_NODE;
+        size += step;
+    }
+
+    uint32_t fl, sl;
+    mapping(size, fl, sl);
+
+    uint32_t sl_map = m_SecondLevel[fl] & (~0u << sl);
+    if (sl_map == 0) {
+        uint64_t fl_map = fl + 1 < 64 ? m_FirstLevel & (~uint64_t(0) << (fl + 1)) : 0;
+        if (fl_map == 0) return INVALID_NODE;
+
+        fl     = static_cast<uint32_t>(std::countr_zero(fl_map));
+        sl_map = m_SecondLevel[fl];
+    }
+
+    sl = static_cast<uint32_t>(std::countr_zero(sl_map));
+    return m_FreeHeads[fl][sl];
+}
+
+void rhi::TLSFAllocator::insertFree(uint32_t index) {
+    uint32_t fl, sl;
+    mapping(m_Nodes[index].size, fl, sl);
+
+    auto& node     = m_Nodes[index];
+    node.free      = true;
+    node.prev_free = INVALID_NODE;
+    node.next_free = m_FreeHeads[fl][sl];
+    if (node.next_free != INVALID_NODE) m_Nodes[node.next_free].prev_free = index;
+
+    m_FreeHeads[fl][sl] = index;
+    m_SecondLevel[fl] |= 1u << sl;
+    m_FirstLevel |= uint64_t(1) << fl;
+}
+
+void rhi::TLSFAllocator::removeFree(uint32_t index) {
+    uint32_t fl, sl;
+    mapping(m_Nodes[index].size, fl, sl);
+
+    auto& node = m_Nodes[index];
+    if (node.prev_free != INVALID_NODE) m_Nodes[node.prev_free].next_free = node.next_free;
+    if (node.next_free != INVALID_NODE) m_Nodes[node.next_free].prev_free = node.prev_free;
+
+    if (m_FreeHeads[fl][sl] == index) {
+        m_FreeHeads[fl][sl] = node.next_free;
+        if (node.next_free == INVALID_NODE) {
+            m_SecondLevel[fl] &= ~(1u << sl);
+            if (m_SecondLevel[fl] == 0) m_FirstLevel &= ~(uint64_t(1) << fl);
+        }
+    }
+
+    node.prev_free = INVALID_NODE;
+    node.next_free = INVALID_NODE;
+}
+
+RHI_NODISCARD uint32_t rhi::TLSFAllocator::createNode() {
+    if (!m_UnusedNodes.empty()) {
+        uint32_t node = m_UnusedNodes.back();
+        m_UnusedNodes.pop_back();
+        return node;
+    }
+
+    m_Nodes.emplace_back();
+    return static_cast<uint32_t>(m_Nodes.size() - 1);
+}
+
+void rhi::TLSFAllocator::releaseNode(uint32_t node) {
+    m_UnusedNodes.push_back(node);
+}
@@ -12,11 +12,137 @@
 =================================================*/
 
 #include "RHI/ResourceManager.hpp"
+#include "Source/Common/Logging.hpp"
+
+#include <algorithm>
+#include <functional>
+
+rhi::ResourceManager::TransientTextureKey::TransientTextureKey(const rhi::TextureDesc& desc)
+    : width(desc.width), height(desc.height), depth(desc.depth), array_size(desc.array_size), mip_levels(desc.mip_levels),
+      sample_count(desc.sample_count), sample_quality(desc.sample_quality), format(desc.format), dimension(desc.dimension),
+      initial_state(desc.initial_state), shared_resource_flags(desc.shared_resource_flags),
+      clear_value(desc.use_clear_value ? desc.clear_value : Color()) {
+    flags = (uint32_t(desc.is_shader_resource) << 0) | (uint32_t(desc.is_render_target) << 1) |
+            (uint32_t(desc.is_uav) << 2) | (uint32_t(desc.is_typeless) << 3) |
+            (uint32_t(desc.is_shading_rate_surface) << 4) | (uint32_t(desc.is_virtual) << 5) |
+            (uint32_t(desc.is_tiled) << 6) | (uint32_t(desc.use_clear_value) << 7) |
+            (uint32_t(desc.keep_initial_state) << 8);
+}
+
+size_t rhi::ResourceManager::TransientTextureKeyHash::operator()(const TransientTextureKey& key) const noexcept {
+    size_t hash    = 0;
+    auto   combine = [&hash](size_t value) { hash ^= value + 0x9e3779b97f4a7c15ull + (hash << 6) + (hash >> 2); };
+
+    combine(key.width);
+    combine(key.height);
+    combine(key.depth);
+    combine(key.array_size);
+    combine(key.mip_levels);
+    combine(key.sample_count);
+    combine(key.sample_quality);
+    combine(size_t(key.format));
+    combine(size_t(key.dimension));
+    combine(size_t(key.initial_state));
+    combine(size_t(key.shared_resource_flags));
+    combine(std::hash<float>()(key.clear_value.r));
+    combine(std::hash<float>()(key.clear_value.g));
+    combine(std::hash<float>()(key.clear_value.b));
+    combine(std::hash<float>()(key.clear_value.a));
+    combine(key.flags);
+
+    return hash;
+}
 
 void rhi::ResourceManager::Release() {
-    for (auto& texture : m_Textures)
-        m_Device.DestroyBackendTexture(texture.backend_handle);
-    m_Textures.clear();
+    m_Device.WaitForIdle();
+
+    if (m_AsyncWorker.joinable()) {
+        m_AsyncWorker.request_stop();
+        m_AsyncWorker.join();
+    }
+
+    // jobs the worker did not get to are dropped, their slots are released below
+    m_AsyncJobs.clear();
+    m_AsyncInFlight = 0;
+    for (auto& result : m_AsyncResults)
+        m_Device.DestroyBackendTexture(result.backend_handle);
+    m_AsyncResults.clear();
+
+    // the device is idle, nothing can reference retired textures anymore
+    for (auto& retired : m_RetiredTextures)
+        m_Device.DestroyBackendTexture(retired.backend_handle);
+    m_RetiredTextures.clear();
+
+    for (auto& [index, streaming] : m_StreamingTextures)
+        m_Device.DestroyBackendTexture(streaming.loading_handle);
+    m_StreamingTextures.clear();
+
+    for (auto& slot : m_TextureSlots) {
+        if (slot.alive)
+            m_Device.DestroyBackendTexture(slot.texture.backend_handle);
+    }
+    m_TextureSlots.clear();
+    m_FreeTextureSlots.clear();
+    m_TextureCount = 0;
+
+    for (auto& bucket : m_TransientBuckets) {
+        for (auto& pooled : bucket.pooled)
+            m_Device.DestroyBackendTexture(pooled.backend_handle);
+    }
+    m_TransientBuckets.clear();
+    m_TransientBucketIndices.clear();
+    m_PooledTextureCount = 0;
+
+    // buffers before the blocks they are placed in
+    for (auto& retired : m_RetiredBuffers)
+        m_Device.DestroyBackendBuffer(retired.backend_handle);
+    m_RetiredBuffers.clear();
+
+    for (auto& slot : m_BufferSlots) {
+        if (slot.alive)
+            m_Device.DestroyBackendBuffer(slot.buffer.backend_handle);
+    }
+    m_BufferSlots.clear();
+    m_FreeBufferSlots.clear();
+    m_BufferCount = 0;
+
+    for (auto& block : m_BufferBlocks)
+        m_Device.DestroyBackendMemoryBlock(block.backend_block);
+    m_BufferBlocks.clear();
+    m_BufferBlockCount = 0;
+
+    m_TextureBytes         = 0;
+    m_BufferBytes          = 0;
+    m_DedicatedBufferBytes = 0;
+    m_RetiredTextureBytes  = 0;
+}
+
+void rhi::ResourceManager::BeginFrame() {
+    this->collectAsyncTextures();
+    this->collectRetiredResources();
+
+    uint64_t frame     = m_Device.getFrameNumber();
+    uint64_t completed = m_Device.getCompletedFrameNumber();
+
+    for (auto& bucket : m_TransientBuckets) {
+        auto& pooled = bucket.pooled;
+        for (size_t i = 0; i < pooled.size();) {
+            bool retired = pooled[i].last_used_frame < completed;
+            bool expired = pooled[i].last_used_frame + m_TransientTextureMaxAge < frame;
+            if (!retired || !expired) {
+                i++;
+                continue;
+            }
+
+            m_Device.DestroyBackendTexture(pooled[i].backend_handle);
+            m_TextureBytes -= pooled[i].byte_size;
+            pooled[i] = pooled.back();
+            pooled.pop_back();
+            m_PooledTextureCount--;
+        }
+    }
+
+    this->enforceBudget();
 }
 
 RHI_NODISCARD rhi::TextureHandle rhi::ResourceManager::CreateTexture(const rhi::TextureDesc& desc) {
@@ -27,19 +153,771 @@ RHI_NODISCARD rhi::TextureHandle rhi::ResourceManager::CreateTexture(const rhi::
 
     texture.backend_handle = m_Device.CreateBackendTexture(desc);
 
-    m_Textures.push_back(texture);
-    return TextureHandle(m_Textures.size() - 1);
+    uint32_t index                  = this->allocateTextureSlot(desc, texture);
+    m_TextureSlots[index].byte_size = m_Device.getBackendTextureMemorySize(texture.backend_handle);
+    m_TextureBytes += m_TextureSlots[index].byte_size;
+
+    return TextureHandle(index, m_TextureSlots[index].generation);
 }
 
 void rhi::ResourceManager::DestroyTexture(TextureHandle handle) {
-    size_t index = static_cast<size_t>(handle);
-    if (index >= m_Textures.size()) {
-        // TODO : ERROR LOGGING
+    if (!this->isValid(handle)) {
+        rhi::logging::error("ResourceManager::DestroyTexture : stale or null handle ( index %u, generation %u )", handle.index, handle.generation);
+        return;
+    }
+
+    // frames already submitted or still being recorded may reference the texture
+    auto& slot = m_TextureSlots[handle.index];
+    if (slot.texture.backend_handle != nullptr) {
+        m_RetiredTextures.push_back({ slot.texture.backend_handle, slot.byte_size, m_Device.getFrameNumber() });
+        m_RetiredTextureBytes += slot.byte_size;
+    }
+    m_TextureBytes -= slot.byte_size;
+
+    // a load in progress may have uploads in flight, so its texture is retired as well
+    auto streaming = m_StreamingTextures.find(handle.index);
+    if (streaming != m_StreamingTextures.end()) {
+        if (streaming->second.loading_handle != nullptr) {
+            m_RetiredTextures.push_back({ streaming->second.loading_handle, streaming->second.loading_bytes, m_Device.getFrameNumber() });
+            m_RetiredTextureBytes += streaming->second.loading_bytes;
+            m_TextureBytes -= streaming->second.loading_bytes;
+        }
+        m_StreamingTextures.erase(streaming);
+    }
+
+    this->freeTextureSlot(handle.index);
+}
+
+RHI_NODISCARD rhi::TextureHandle rhi::ResourceManager::CreateTextureAsync(const rhi::TextureDesc& desc, TextureReadyCallback on_ready) {
+    Texture texture{};
+    texture.width  = desc.width;
+    texture.height = desc.height;
+    texture.format = desc.format;
+
+    uint32_t index                = this->allocateTextureSlot(desc, texture);
+    m_TextureSlots[index].pending = true;
+
+    TextureHandle handle(index, m_TextureSlots[index].generation);
+    {
+        std::lock_guard lock(m_AsyncMutex);
+        m_AsyncJobs.push_back({ desc, handle, std::move(on_ready) });
+        m_AsyncInFlight++;
+    }
+
+    if (!m_AsyncWorker.joinable())
+        m_AsyncWorker = std::jthread([this](std::stop_token stop) { this->asyncWorker(stop); });
+    m_AsyncCondition.notify_one();
+
+    return handle;
+}
+
+void rhi::ResourceManager::FlushAsyncTextures() {
+    {
+        std::unique_lock lock(m_AsyncMutex);
+        m_AsyncCondition.wait(lock, [this] { return m_AsyncInFlight == 0; });
+    }
+    this->collectAsyncTextures();
+}
+
+RHI_NODISCARD rhi::ResourceManager::TextureState rhi::ResourceManager::getTextureState(TextureHandle handle) {
+    if (this->isValid(handle) && m_TextureSlots[handle.index].pending)
+        this->collectAsyncTextures();
+
+    if (!this->isValid(handle)) return TextureState::Invalid;
+
+    const auto& slot = m_TextureSlots[handle.index];
+    if (slot.pending) return TextureState::Pending;
+    return slot.evicted ? TextureState::Evicted : TextureState::Ready;
+}
+
+void rhi::ResourceManager::MarkUsed(TextureHandle handle) {
+    if (!this->isValid(handle)) {
+        rhi::logging::error("ResourceManager::MarkUsed : stale or null handle ( index %u, generation %u )", handle.index, handle.generation);
         return;
     }
 
-    auto& texture = this->getTexture(handle);
-    m_Device.DestroyBackendTexture(texture.backend_handle);
+    m_TextureSlots[handle.index].last_used_frame = m_Device.getFrameNumber();
+}
+
+void rhi::ResourceManager::setEvictable(TextureHandle handle, bool evictable) {
+    if (!this->isValid(handle)) {
+        rhi::logging::error("ResourceManager::setEvictable : stale or null handle ( index %u, generation %u )", handle.index, handle.generation);
+        return;
+    }
+
+    auto& slot = m_TextureSlots[handle.index];
+    if (slot.transient_bucket != TextureSlot::NOT_TRANSIENT) {
+        rhi::logging::error("ResourceManager::setEvictable : transient texture ( index %u ) cannot be evicted", handle.index);
+        return;
+    }
+
+    if (m_StreamingTextures.contains(handle.index)) {
+        rhi::logging::error("ResourceManager::setEvictable : streaming texture ( index %u ) drops mips instead", handle.index);
+        return;
+    }
+
+    slot.evictable = evictable;
+}
+
+void rhi::ResourceManager::RestoreTexture(TextureHandle handle) {
+    if (this->getTextureState(handle) != TextureState::Evicted) {
+        rhi::logging::error("ResourceManager::RestoreTexture : handle ( index %u, generation %u ) is not evicted", handle.index, handle.generation);
+        return;
+    }
+
+    // the texture stays Evicted, a later call may try again
+    void* backend_handle = m_Device.CreateBackendTexture(m_TextureSlots[handle.index].desc);
+    if (backend_handle == nullptr) {
+        rhi::logging::error("ResourceManager::RestoreTexture : failed to recreate texture ( index %u )", handle.index);
+        return;
+    }
+
+    auto& slot                  = m_TextureSlots[handle.index];
+    slot.texture.backend_handle = backend_handle;
+    slot.byte_size              = m_Device.getBackendTextureMemorySize(backend_handle);
+    slot.last_used_frame        = m_Device.getFrameNumber();
+    slot.evicted                = false;
+    m_TextureBytes += slot.byte_size;
+}
+
+RHI_NODISCARD rhi::TextureHandle rhi::ResourceManager::CreateStreamingTexture(const rhi::TextureDesc& desc, uint32_t tail_mips, MipLoadCallback on_load) {
+    assert(on_load && "a streaming texture needs a loader");
+
+    // the uploads leave every mip in SHADER_READ_ONLY_OPTIMAL, command lists have to start tracking from there
+    rhi::TextureDesc stream_desc = desc;
+    stream_desc.enableAutomaticStateTracking(ResourceStates::ShaderResource);
+
+    Texture texture{};
+    texture.width  = desc.width;
+    texture.height = desc.height;
+    texture.format = desc.format;
+
+    uint32_t index                = this->allocateTextureSlot(stream_desc, texture);
+    m_TextureSlots[index].pending = true; // until the tail is loaded
+
+    uint32_t tail_mip = desc.mip_levels - std::clamp(tail_mips, 1u, desc.mip_levels);
+
+    auto& streaming         = m_StreamingTextures[index];
+    streaming               = StreamingTexture{};
+    streaming.on_load       = std::move(on_load);
+    streaming.tail_mip      = tail_mip;
+    streaming.resident_mip  = desc.mip_levels;
+    streaming.requested_mip = tail_mip;
+
+    TextureHandle handle(index, m_TextureSlots[index].generation);
+    if (this->startStreamingLoad(index, tail_mip)) this->requestStreamingMips({ handle });
+
+    return handle;
+}
+
+void rhi::ResourceManager::RequestStreamingMip(TextureHandle handle, uint32_t mip_level) {
+    auto streaming = this->isValid(handle) ? m_StreamingTextures.find(handle.index) : m_StreamingTextures.end();
+    if (streaming == m_StreamingTextures.end()) {
+        rhi::logging::error("ResourceManager::RequestStreamingMip : stale, null or not streaming handle ( index %u, generation %u )", handle.index, handle.generation);
+        return;
+    }
+
+    streaming->second.requested_mip = std::min(mip_level, streaming->second.tail_mip);
+}
+
+void rhi::ResourceManager::UploadStreamingMip(TextureHandle handle, uint32_t mip_level, uint32_t array_slice, const void* data, uint64_t row_pitch) {
+    auto it = this->isValid(handle) ? m_StreamingTextures.find(handle.index) : m_StreamingTextures.end();
+    if (it == m_StreamingTextures.end()) {
+        rhi::logging::error("ResourceManager::UploadStreamingMip : stale, null or not streaming handle ( index %u, generation %u )", handle.index, handle.generation);
+        return;
+    }
+
+    auto&       streaming = it->second;
+    const auto& desc      = m_TextureSlots[handle.index].desc;
+    if (streaming.loading_mip == StreamingTexture::NOT_LOADING || mip_level < streaming.loading_mip ||
+        mip_level >= streaming.copied_mip || array_slice >= desc.array_size) {
+        rhi::logging::error("ResourceManager::UploadStreamingMip : mip %u, slice %u is not part of a load in progress", mip_level, array_slice);
+        return;
+    }
+
+    m_Device.UploadBackendTexture(streaming.loading_handle, mip_level - streaming.loading_mip, array_slice, data, row_pitch);
+
+    // the same subresource uploaded twice just overwrites it
+    size_t subresource = size_t(mip_level - streaming.loading_mip) * desc.array_size + array_slice;
+    if (streaming.uploaded[subresource]) return;
+
+    streaming.uploaded[subresource] = true;
+    if (--streaming.remaining == 0) this->finishStreamingLoad(handle.index);
+}
+
+RHI_NODISCARD uint32_t rhi::ResourceManager::getStreamingMip(TextureHandle handle) const {
+    auto streaming = this->isValid(handle) ? m_StreamingTextures.find(handle.index) : m_StreamingTextures.end();
+    return streaming != m_StreamingTextures.end() ? streaming->second.resident_mip : 0;
+}
+
+void rhi::ResourceManager::UploadTexture(TextureHandle handle, uint32_t mip_level, uint32_t array_slice, const void* data, uint64_t row_pitch) {
+    if (this->getTextureState(handle) != TextureState::Ready) {
+        rhi::logging::error("ResourceManager::UploadTexture : stale, null, pending or evicted handle ( index %u, generation %u )", handle.index, handle.generation);
+        return;
+    }
+
+    if (m_StreamingTextures.contains(handle.index)) {
+        rhi::logging::error("ResourceManager::UploadTexture : streaming texture ( index %u ) is loaded through UploadStreamingMip", handle.index);
+        return;
+    }
+
+    m_Device.UploadBackendTexture(m_TextureSlots[handle.index].texture.backend_handle, mip_level, array_slice, data, row_pitch);
+}
+
+void rhi::ResourceManager::UploadBuffer(BufferHandle handle, uint64_t offset, const void* data, uint64_t size) {
+    if (!this->isValid(handle)) {
+        rhi::logging::error("ResourceManager::UploadBuffer : stale or null handle ( index %u, generation %u )", handle.index, handle.generation);
+        return;
+    }
+
+    m_Device.UploadBackendBuffer(m_BufferSlots[handle.index].buffer.backend_handle, offset, data, size);
+}
+
+RHI_NODISCARD rhi::TextureHandle rhi::ResourceManager::AcquireTransientTexture(const rhi::TextureDesc& desc) {
+    auto [it, inserted] = m_TransientBucketIndices.try_emplace(TransientTextureKey(desc), uint32_t(m_TransientBuckets.size()));
+    if (inserted) m_TransientBuckets.emplace_back();
+
+    uint32_t bucket_index = it->second;
+    auto&    pooled       = m_TransientBuckets[bucket_index].pooled;
+
+    Texture texture{};
+    texture.width  = desc.width;
+    texture.height = desc.height;
+    texture.format = desc.format;
+
+    uint64_t byte_size = 0;
+    uint64_t completed = pooled.empty() ? 0 : m_Device.getCompletedFrameNumber();
+    for (size_t i = 0; i < pooled.size(); i++) {
+        if (pooled[i].last_used_frame >= completed) continue; // still referenced by a frame in flight
+
+        texture.backend_handle = pooled[i].backend_handle;
+        byte_size              = pooled[i].byte_size;
+        pooled[i]              = pooled.back();
+        pooled.pop_back();
+        m_PooledTextureCount--;
+        break;
+    }
+
+    if (texture.backend_handle == nullptr) {
+        texture.backend_handle = m_Device.CreateBackendTexture(desc);
+        byte_size              = m_Device.getBackendTextureMemorySize(texture.backend_handle);
+        m_TextureBytes += byte_size;
+    }
+
+    uint32_t index                         = this->allocateTextureSlot(desc, texture);
+    m_TextureSlots[index].transient_bucket = bucket_index;
+    m_TextureSlots[index].byte_size        = byte_size;
+    return TextureHandle(index, m_TextureSlots[index].generation);
+}
+
+void rhi::ResourceManager::ReleaseTransientTexture(TextureHandle handle) {
+    if (!this->isValid(handle)) {
+        rhi::logging::error("ResourceManager::ReleaseTransientTexture : stale or null handle ( index %u, generation %u )", handle.index, handle.generation);
+        return;
+    }
+
+    auto& slot = m_TextureSlots[handle.index];
+    if (slot.transient_bucket == TextureSlot::NOT_TRANSIENT) {
+        rhi::logging::error("ResourceManager::ReleaseTransientTexture : texture ( index %u ) was not acquired as transient, use DestroyTexture", handle.index);
+        return;
+    }
 
-    m_Textures.erase(m_Textures.begin() + index);
+    // the frame being recorded may still use the texture, it becomes reusable once that frame completes
+    PooledTexture pooled{};
+    pooled.backend_handle  = slot.texture.backend_handle;
+    pooled.byte_size       = slot.byte_size;
+    pooled.last_used_frame = m_Device.getFrameNumber();
+
+    m_TransientBuckets[slot.transient_bucket].pooled.push_back(pooled);
+    m_PooledTextureCount++;
+
+    this->freeTextureSlot(handle.index);
+}
+
+RHI_NODISCARD rhi::BufferHandle rhi::ResourceManager::CreateBuffer(const rhi::BufferDesc& desc) {
+    Buffer buffer{};
+    buffer.byte_size  = desc.byte_size;
+    buffer.cpu_access = desc.cpu_access;
+
+    uint32_t                  block     = BufferSlot::DEDICATED;
+    uint64_t                  byte_size = 0;
+    TLSFAllocator::Allocation allocation{};
+
+    // small buffers are created without memory and bound into a shared block
+    if (desc.byte_size <= MAX_PLACED_BUFFER_SIZE && desc.shared_resource_flags == SharedResourceFlags::None) {
+        void* backend_handle = m_Device.CreateBackendBuffer(desc, true);
+        if (backend_handle != nullptr) {
+            MemoryRequirements requirements = m_Device.getBackendBufferMemoryRequirements(backend_handle);
+
+            bool placed = this->allocateBufferMemory(requirements, desc.cpu_access, block, allocation) &&
+                          m_Device.BindBackendBufferMemory(backend_handle, m_BufferBlocks[block].backend_block, allocation.offset);
+
+            if (placed) {
+                buffer.backend_handle = backend_handle;
+                byte_size             = allocation.size;
+            } else {
+                if (allocation.isValid()) this->freeBufferMemory(block, allocation);
+                m_Device.DestroyBackendBuffer(backend_handle); // never used by the GPU, no need to retire it
+
+                block      = BufferSlot::DEDICATED;
+                allocation = {};
+            }
+        }
+    }
+
+    if (buffer.backend_handle == nullptr) {
+        buffer.backend_handle = m_Device.CreateBackendBuffer(desc, false);
+        if (buffer.backend_handle == nullptr) {
+            rhi::logging::error("ResourceManager::CreateBuffer : failed to create a buffer of %llu bytes", desc.byte_size);
+            return BufferHandle{};
+        }
+
+        byte_size = m_Device.getBackendBufferMemoryRequirements(buffer.backend_handle).size;
+        m_DedicatedBufferBytes += byte_size;
+    }
+
+    uint32_t index;
+    if (!m_FreeBufferSlots.empty()) {
+        index = m_FreeBufferSlots.back();
+        m_FreeBufferSlots.pop_back();
+    } else {
+        index = static_cast<uint32_t>(m_BufferSlots.size());
+        m_BufferSlots.emplace_back();
+    }
+
+    auto& slot      = m_BufferSlots[index];
+    slot.buffer     = buffer;
+    slot.allocation = allocation;
+    slot.byte_size  = byte_size;
+    slot.block      = block;
+    slot.alive      = true;
+    m_BufferCount++;
+    m_BufferBytes += byte_size;
+
+    return BufferHandle(index, slot.generation);
+}
+
+void rhi::ResourceManager::DestroyBuffer(BufferHandle handle) {
+    if (!this->isValid(handle)) {
+        rhi::logging::error("ResourceManager::DestroyBuffer : stale or null handle ( index %u, generation %u )", handle.index, handle.generation);
+        return;
+    }
+
+    auto& slot = m_BufferSlots[handle.index];
+    m_RetiredBuffers.push_back({ slot.buffer.backend_handle, slot.block, slot.allocation, m_Device.getFrameNumber() });
+
+    m_BufferBytes -= slot.byte_size;
+    if (slot.block == BufferSlot::DEDICATED) m_DedicatedBufferBytes -= slot.byte_size;
+
+    slot.buffer     = Buffer{};
+    slot.allocation = {};
+    slot.byte_size  = 0;
+    slot.block      = BufferSlot::DEDICATED;
+    slot.alive      = false;
+    if (++slot.generation == 0) slot.generation = 1; // 0 is reserved for null handles
+
+    m_FreeBufferSlots.push_back(handle.index);
+    m_BufferCount--;
+}
+
+RHI_NODISCARD bool rhi::ResourceManager::allocateBufferMemory(const MemoryRequirements& requirements, CpuAccessMode cpu_access, uint32_t& block, TLSFAllocator::Allocation& allocation) {
+    if (requirements.size > MAX_PLACED_BUFFER_SIZE) return false;
+    uint64_t alignment = std::max<uint64_t>(requirements.alignment, 1);
+
+    for (uint32_t i = 0; i < m_BufferBlocks.size(); i++) {
+        auto& candidate = m_BufferBlocks[i];
+        if (candidate.backend_block == nullptr || candidate.cpu_access != cpu_access) continue;
+
+        allocation = candidate.allocator.Allocate(requirements.size, alignment);
+        if (allocation.isValid()) {
+            block = i;
+            return true;
+        }
+    }
+
+    // every block of this kind is full
+    void* backend_block = m_Device.CreateBackendMemoryBlock(BUFFER_BLOCK_SIZE, cpu_access);
+    if (backend_block == nullptr) return false;
+
+    uint32_t index = 0;
+    while (index < m_BufferBlocks.size() && m_BufferBlocks[index].backend_block != nullptr)
+        index++;
+    if (index == m_BufferBlocks.size()) m_BufferBlocks.emplace_back();
+
+    auto& created         = m_BufferBlocks[index];
+    created.backend_block = backend_block;
+    created.cpu_access    = cpu_access;
+    created.allocator     = TLSFAllocator(BUFFER_BLOCK_SIZE);
+    m_BufferBlockCount++;
+
+    allocation = created.allocator.Allocate(requirements.size, alignment);
+    block      = index;
+    return allocation.isValid();
+}
+
+void rhi::ResourceManager::freeBufferMemory(uint32_t block, const TLSFAllocator::Allocation& allocation) {
+    auto& owner = m_BufferBlocks[block];
+    owner.allocator.Free(allocation);
+    if (!owner.allocator.isEmpty()) return;
+
+    // keep one empty block of each kind around, so a buffer created and destroyed every frame does not
+    // create and destroy a block every frame as well
+    for (uint32_t i = 0; i < m_BufferBlocks.size(); i++) {
+        auto& other = m_BufferBlocks[i];
+        if (i == block || other.backend_block == nullptr || other.cpu_access != owner.cpu_access) continue;
+        if (!other.allocator.isEmpty()) continue;
+
+        m_Device.DestroyBackendMemoryBlock(owner.backend_block);
+        owner.backend_block = nullptr;
+        owner.allocator     = TLSFAllocator();
+        m_BufferBlockCount--;
+        return;
+    }
+}
+
+uint32_t rhi::ResourceManager::allocateTextureSlot(const rhi::TextureDesc& desc, const Texture& texture) {
+    uint32_t index;
+    if (!m_FreeTextureSlots.empty()) {
+        index = m_FreeTextureSlots.back();
+        m_FreeTextureSlots.pop_back();
+    } else {
+        index = static_cast<uint32_t>(m_TextureSlots.size());
+        m_TextureSlots.emplace_back();
+    }
+
+    auto& slot           = m_TextureSlots[index];
+    slot.texture         = texture;
+    slot.desc            = desc;
+    slot.last_used_frame = m_Device.getFrameNumber();
+    slot.alive           = true;
+    m_TextureCount++;
+
+    return index;
+}
+
+void rhi::ResourceManager::freeTextureSlot(uint32_t index) {
+    auto& slot = m_TextureSlots[index];
+
+    slot.texture          = Texture{};
+    slot.desc             = rhi::TextureDesc{};
+    slot.byte_size        = 0;
+    slot.transient_bucket = TextureSlot::NOT_TRANSIENT;
+    slot.alive            = false;
+    slot.pending          = false;
+    slot.evictable        = false;
+    slot.evicted          = false;
+    if (++slot.generation == 0) slot.generation = 1; // 0 is reserved for null handles
+
+    m_FreeTextureSlots.push_back(index);
+    m_TextureCount--;
+}
+
+void rhi::ResourceManager::enforceBudget() {
+    m_MemoryBudget = m_Device.getMemoryBudget();
+    if (m_MemoryBudget.budget == 0 || m_BudgetUsageLimit <= 0.0f) {
+        this->growStreamingTextures(UINT64_MAX);
+        return;
+    }
+
+    // a device that cannot query its usage reports 0, what this manager holds is the best guess then.
+    // Retired textures are still in the device's usage, but they are already on their way out
+    uint64_t device_usage = m_MemoryBudget.usage - std::min(m_MemoryBudget.usage, m_RetiredTextureBytes);
+    uint64_t usage        = std::max(device_usage, this->getAllocatedBytes());
+    uint64_t limit        = static_cast<uint64_t>(static_cast<double>(m_MemoryBudget.budget) * m_BudgetUsageLimit);
+    if (usage <= limit) {
+        this->growStreamingTextures(limit - usage);
+        return;
+    }
+
+    uint64_t excess    = usage - limit;
+    uint64_t completed = m_Device.getCompletedFrameNumber();
+
+    // pooled transient textures hold no contents, the ones no frame in flight uses go first
+    for (auto& bucket : m_TransientBuckets) {
+        auto& pooled = bucket.pooled;
+        for (size_t i = 0; i < pooled.size() && excess > 0;) {
+            if (pooled[i].last_used_frame >= completed) {
+                i++;
+                continue;
+            }
+
+            m_Device.DestroyBackendTexture(pooled[i].backend_handle);
+            m_TextureBytes -= pooled[i].byte_size;
+            excess -= std::min(excess, pooled[i].byte_size);
+            pooled[i] = pooled.back();
+            pooled.pop_back();
+            m_PooledTextureCount--;
+        }
+    }
+
+    // then fine mips of streaming textures
+    if (excess > 0) excess = this->shrinkStreamingTextures(excess);
+    if (excess == 0) return;
+
+    // then the coldest evictable textures, by their last MarkUsed
+    uint64_t              frame = m_Device.getFrameNumber();
+    std::vector<uint32_t> candidates;
+    for (uint32_t i = 0; i < m_TextureSlots.size(); i++) {
+        const auto& slot = m_TextureSlots[i];
+        if (!slot.alive || !slot.evictable || slot.pending || slot.evicted) continue;
+        if (slot.last_used_frame + m_EvictionMinAge >= frame) continue;
+
+        candidates.push_back(i);
+    }
+
+    std::sort(candidates.begin(), candidates.end(), [this](uint32_t lhs, uint32_t rhs) {
+        return m_TextureSlots[lhs].last_used_frame < m_TextureSlots[rhs].last_used_frame;
+    });
+
+    for (size_t i = 0; i < candidates.size() && excess > 0; i++) {
+        excess -= std::min(excess, m_TextureSlots[candidates[i]].byte_size);
+        this->evictTexture(candidates[i]);
+    }
+}
+
+void rhi::ResourceManager::evictTexture(uint32_t index) {
+    auto& slot = m_TextureSlots[index];
+
+    // frames in flight may still sample it, like DestroyTexture
+    m_RetiredTextures.push_back({ slot.texture.backend_handle, slot.byte_size, m_Device.getFrameNumber() });
+    m_RetiredTextureBytes += slot.byte_size;
+    m_TextureBytes -= slot.byte_size;
+
+    slot.texture.backend_handle = nullptr;
+    slot.byte_size              = 0;
+    slot.evicted                = true;
+}
+
+RHI_NODISCARD rhi::TextureDesc rhi::ResourceManager::getMipChainDesc(const rhi::TextureDesc& desc, uint32_t first_mip) {
+    rhi::TextureDesc chain = desc;
+    chain.width            = std::max(desc.width >> first_mip, 1u);
+    chain.height           = std::max(desc.height >> first_mip, 1u);
+    chain.mip_levels       = desc.mip_levels - first_mip;
+
+    if (desc.dimension == TextureDimension::Texture3D)
+        chain.depth = std::max(desc.depth >> first_mip, 1u);
+
+    return chain;
+}
+
+void rhi::ResourceManager::growStreamingTextures(uint64_t headroom) {
+    std::vector<uint32_t> candidates;
+    for (auto& [index, streaming] : m_StreamingTextures) {
+        if (streaming.loading_mip == StreamingTexture::NOT_LOADING && streaming.requested_mip < streaming.resident_mip)
+            candidates.push_back(index);
+    }
+
+    // the most recently used ones get the headroom first
+    std::sort(candidates.begin(), candidates.end(), [this](uint32_t lhs, uint32_t rhs) {
+        return m_TextureSlots[lhs].last_used_frame > m_TextureSlots[rhs].last_used_frame;
+    });
+
+    std::vector<TextureHandle> loads;
+    for (uint32_t index : candidates) {
+        const auto& slot      = m_TextureSlots[index];
+        const auto& streaming = m_StreamingTextures[index];
+
+        // an estimate, every finer mip is about 4x ( 8x for 3D ) the size of the chain below it
+        uint32_t shift    = (slot.desc.dimension == TextureDimension::Texture3D ? 3 : 2) * (streaming.resident_mip - streaming.requested_mip);
+        uint64_t estimate = shift < 64 && slot.byte_size <= (UINT64_MAX >> shift) ? slot.byte_size << shift : UINT64_MAX;
+        if (estimate > headroom) continue;
+
+        if (!this->startStreamingLoad(index, streaming.requested_mip)) continue;
+
+        headroom -= estimate;
+        loads.emplace_back(index, slot.generation);
+    }
+
+    this->requestStreamingMips(loads);
+}
+
+RHI_NODISCARD uint64_t rhi::ResourceManager::shrinkStreamingTextures(uint64_t excess) {
+    std::vector<uint32_t> candidates;
+    for (auto& [index, streaming] : m_StreamingTextures) {
+        if (streaming.loading_mip == StreamingTexture::NOT_LOADING && streaming.resident_mip < streaming.tail_mip)
+            candidates.push_back(index);
+    }
+
+    // mips the renderer no longer asks for go first, then the coldest textures
+    std::sort(candidates.begin(), candidates.end(), [this](uint32_t lhs, uint32_t rhs) {
+        const auto& left  = m_StreamingTextures[lhs];
+        const auto& right = m_StreamingTextures[rhs];
+
+        bool left_unused  = left.requested_mip > left.resident_mip;
+        bool right_unused = right.requested_mip > right.resident_mip;
+        if (left_unused != right_unused) return left_unused;
+
+        return m_TextureSlots[lhs].last_used_frame < m_TextureSlots[rhs].last_used_frame;
+    });
+
+    // the kept mips are copied GPU-side into a texture of the smaller chain, which replaces the full one right away.
+    // Nothing is read again through the loader, and only the new texture is allocated before the full one retires
+    for (size_t i = 0; i < candidates.size() && excess > 0; i++) {
+        uint32_t index     = candidates[i];
+        auto&    slot      = m_TextureSlots[index];
+        auto&    streaming = m_StreamingTextures[index];
+
+        // down to what was requested, or one mip when the renderer still wants them all
+        uint32_t first_mip = std::max(streaming.resident_mip + 1, streaming.requested_mip);
+        void*    smaller   = m_Device.CreateBackendTexture(getMipChainDesc(slot.desc, first_mip));
+        if (smaller == nullptr) {
+            rhi::logging::error("ResourceManager::shrinkStreamingTextures : failed to create mips %u+ of texture ( index %u )", first_mip, index);
+            continue;
+        }
+
+        uint64_t smaller_bytes = m_Device.getBackendTextureMemorySize(smaller);
+        m_Device.CopyBackendTextureMips(smaller, 0, slot.texture.backend_handle, first_mip - streaming.resident_mip, slot.desc.mip_levels - first_mip);
+
+        // frames in flight may still sample the full one
+        m_RetiredTextures.push_back({ slot.texture.backend_handle, slot.byte_size, m_Device.getFrameNumber() });
+        m_RetiredTextureBytes += slot.byte_size;
+        m_TextureBytes = m_TextureBytes - slot.byte_size + smaller_bytes;
+
+        excess -= std::min(excess, slot.byte_size - std::min(slot.byte_size, smaller_bytes));
+
+        slot.texture.backend_handle = smaller;
+        slot.byte_size              = smaller_bytes;
+        streaming.resident_mip      = first_mip;
+    }
+
+    return excess;
+}
+
+RHI_NODISCARD bool rhi::ResourceManager::startStreamingLoad(uint32_t index, uint32_t first_mip) {
+    const auto& desc      = m_TextureSlots[index].desc;
+    auto&       streaming = m_StreamingTextures[index];
+
+    // the resident chain stays as it is, a later BeginFrame may try again
+    void* loading_handle = m_Device.CreateBackendTexture(getMipChainDesc(desc, first_mip));
+    if (loading_handle == nullptr) {
+        rhi::logging::error("ResourceManager::startStreamingLoad : failed to create mips %u+ of texture ( index %u )", first_mip, index);
+        return false;
+    }
+
+    // the resident mips are already on the GPU, only the finer ones go through the loader
+    const auto& resident = m_TextureSlots[index].texture;
+    uint32_t    copied   = resident.backend_handle != nullptr ? streaming.resident_mip : desc.mip_levels;
+    if (copied < desc.mip_levels)
+        m_Device.CopyBackendTextureMips(loading_handle, copied - first_mip, resident.backend_handle, 0, desc.mip_levels - copied);
+
+    streaming.loading_handle = loading_handle;
+    streaming.loading_bytes  = m_Device.getBackendTextureMemorySize(loading_handle);
+    streaming.loading_mip    = first_mip;
+    streaming.copied_mip     = copied;
+    streaming.remaining      = (copied - first_mip) * desc.array_size;
+    streaming.uploaded.assign(streaming.remaining, false);
+
+    m_TextureBytes += streaming.loading_bytes;
+    return true;
+}
+
+void rhi::ResourceManager::requestStreamingMips(const std::vector<TextureHandle>& handles) {
+    for (TextureHandle handle : handles) {
+        auto streaming = this->isValid(handle) ? m_StreamingTextures.find(handle.index) : m_StreamingTextures.end();
+        if (streaming == m_StreamingTextures.end() || streaming->second.loading_mip == StreamingTexture::NOT_LOADING) continue;
+
+        // copied, the loader may destroy the texture and its callback with it
+        MipLoadCallback on_load   = streaming->second.on_load;
+        uint32_t        first_mip = streaming->second.loading_mip;
+        uint32_t        end_mip   = streaming->second.copied_mip;
+
+        // coarsest first, in case the loader works through them in order
+        for (uint32_t mip = end_mip; mip-- > first_mip && this->isValid(handle);)
+            on_load(handle, mip);
+    }
+}
+
+void rhi::ResourceManager::finishStreamingLoad(uint32_t index) {
+    auto& slot      = m_TextureSlots[index];
+    auto& streaming = m_StreamingTextures[index];
+
+    // the uploads are flushed with the next Submit, ahead of the frame's own work,
+    // so the new texture can be used right away. The old one may still be in use by frames in flight
+    if (slot.texture.backend_handle != nullptr) {
+        m_RetiredTextures.push_back({ slot.texture.backend_handle, slot.byte_size, m_Device.getFrameNumber() });
+        m_RetiredTextureBytes += slot.byte_size;
+    }
+    m_TextureBytes -= slot.byte_size;
+
+    slot.texture.backend_handle = streaming.loading_handle;
+    slot.byte_size              = streaming.loading_bytes;
+    slot.pending                = false;
+
+    streaming.resident_mip   = streaming.loading_mip;
+    streaming.loading_mip    = StreamingTexture::NOT_LOADING;
+    streaming.loading_handle = nullptr;
+    streaming.loading_bytes  = 0;
+    streaming.uploaded.clear();
+}
+
+void rhi::ResourceManager::collectAsyncTextures() {
+    std::vector<AsyncTextureResult> results;
+    {
+        std::lock_guard lock(m_AsyncMutex);
+        if (m_AsyncResults.empty()) return;
+        results.swap(m_AsyncResults);
+    }
+
+    for (auto& result : results) {
+        // destroyed while pending : the slot moved on to a new generation, nobody wants this texture
+        if (!this->isValid(result.handle)) {
+            m_Device.DestroyBackendTexture(result.backend_handle);
+            continue;
+        }
+
+        // failed : the slot is freed, so the handle reads as Invalid and on_ready never runs
+        if (result.backend_handle == nullptr) {
+            rhi::logging::error("ResourceManager::CreateTextureAsync : failed to create texture ( index %u )", result.handle.index);
+            this->freeTextureSlot(result.handle.index);
+            continue;
+        }
+
+        auto& slot                  = m_TextureSlots[result.handle.index];
+        slot.texture.backend_handle = result.backend_handle;
+        slot.byte_size              = m_Device.getBackendTextureMemorySize(result.backend_handle);
+        slot.pending                = false;
+        m_TextureBytes += slot.byte_size;
+    }
+
+    // callbacks last, they may create or destroy textures
+    for (auto& result : results) {
+        if (result.on_ready && this->isValid(result.handle))
+            result.on_ready(result.handle);
+    }
+}
+
+void rhi::ResourceManager::collectRetiredResources() {
+    if (m_RetiredTextures.empty() && m_RetiredBuffers.empty()) return;
+
+    uint64_t completed = m_Device.getCompletedFrameNumber();
+    while (!m_RetiredTextures.empty() && m_RetiredTextures.front().last_used_frame < completed) {
+        m_Device.DestroyBackendTexture(m_RetiredTextures.front().backend_handle);
+        m_RetiredTextureBytes -= m_RetiredTextures.front().byte_size;
+        m_RetiredTextures.pop_front();
+    }
+
+    while (!m_RetiredBuffers.empty() && m_RetiredBuffers.front().last_used_frame < completed) {
+        auto& retired = m_RetiredBuffers.front();
+        m_Device.DestroyBackendBuffer(retired.backend_handle);
+        if (retired.block != BufferSlot::DEDICATED) this->freeBufferMemory(retired.block, retired.allocation);
+
+        m_RetiredBuffers.pop_front();
+    }
+}
+
+void rhi::ResourceManager::asyncWorker(std::stop_token stop) {
+    std::unique_lock lock(m_AsyncMutex);
+    while (m_AsyncCondition.wait(lock, stop, [this] { return !m_AsyncJobs.empty(); })) {
+        AsyncTextureJob job = std::move(m_AsyncJobs.front());
+        m_AsyncJobs.pop_front();
+
+        // the backend object is created outside the lock, rhi::Device::CreateBackendTexture may be called from any thread
+        lock.unlock();
+        void* backend_handle = m_Device.CreateBackendTexture(job.desc);
+        lock.lock();
+
+        m_AsyncResults.push_back({ job.handle, backend_handle, std::move(job.on_ready) });
+        m_AsyncInFlight--;
+        m_AsyncCondition.notify_all();
+    }
 }
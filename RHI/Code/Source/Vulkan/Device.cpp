@@ -23,6 +23,8 @@
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
 
+#include <algorithm>
+#include <cstring>
 #include <iostream>
 #include <unordered_set>
 
@@ -77,6 +79,8 @@ rhi::vulkan::Device::Device() {
 }
 
 rhi::vulkan::Device::~Device() {
+    m_Uploader.Release();
+
     DestroyDebugUtilsMessengerEXT(m_Context.instance, m_DebugMessenger, nullptr);
     vkDestroySurfaceKHR(m_Context.instance, m_Surface, nullptr);
     vkDestroyInstance(m_Context.instance, nullptr);
@@ -110,21 +114,65 @@ void rhi::vulkan::Device::Submit(rhi::CommandList* cmd) {
     auto& frame  = m_Frames[m_FrameIndex];
     auto* vk_cmd = static_cast<rhi::vulkan::CommandList*>(cmd);
 
-    nvrhi::ICommandList* lists[] = {
-        vk_cmd->getNVRHICommandList()
-    };
+    // the frame that used this slot last has to finish before its query can be reused
+    if (m_FrameNumber >= m_Frames.size()) {
+        m_NVRHIDevice->waitEventQuery(frame.frame_complete);
+        m_CompletedFrameNumber = std::max(m_CompletedFrameNumber, m_FrameNumber - m_Frames.size() + 1);
+    }
+    m_NVRHIDevice->resetEventQuery(frame.frame_complete);
+
+    // the uploads recorded since the last frame go first, and the frame's graphics work acquires them
+    m_Uploader.Flush();
+    nvrhi::ICommandList* acquire = m_Uploader.RecordAcquire();
+
+    // then the texture copies, which may read what was just uploaded
+    nvrhi::ICommandList* lists[3]{};
+    uint32_t             list_count = 0;
+
+    if (acquire != nullptr) lists[list_count++] = acquire;
+    if (m_RecordingTextureCopies) {
+        m_TextureCopyCommandList->close();
+        m_RecordingTextureCopies = false;
+        lists[list_count++]      = m_TextureCopyCommandList;
+    }
+    lists[list_count++] = vk_cmd->getNVRHICommandList();
+
+    m_NVRHIDevice->executeCommandLists(lists, list_count, nvrhi::CommandQueue::Graphics);
 
-    m_NVRHIDevice->executeCommandLists(
-        lists,
-        1,
-        nvrhi::CommandQueue::Graphics);
+    m_NVRHIDevice->setEventQuery(frame.frame_complete, nvrhi::CommandQueue::Graphics);
 
+    m_FrameNumber++;
     m_FrameIndex = (m_FrameIndex + 1) % m_Frames.size();
 }
 
+RHI_NODISCARD uint64_t rhi::vulkan::Device::getCompletedFrameNumber() {
+    // frames finish in submission order, so stop at the first one still running
+    while (m_CompletedFrameNumber < m_FrameNumber) {
+        auto& frame = m_Frames[m_CompletedFrameNumber % m_Frames.size()];
+        if (!m_NVRHIDevice->pollEventQuery(frame.frame_complete)) break;
+
+        m_CompletedFrameNumber++;
+    }
+
+    return m_CompletedFrameNumber;
+}
+
+void rhi::vulkan::Device::WaitForIdle() {
+    m_NVRHIDevice->waitForIdle();
+    m_CompletedFrameNumber = m_FrameNumber;
+}
+
 RHI_NODISCARD void* rhi::vulkan::Device::CreateBackendTexture(const rhi::TextureDesc& desc) {
     nvrhi::TextureHandle handle = m_NVRHIDevice->createTexture(rhi::to_nvrhi(desc));
-    return static_cast<void*>(handle.Get());
+    return static_cast<void*>(handle.Detach()); // the reference is dropped by DestroyBackendTexture
+}
+
+RHI_NODISCARD uint64_t rhi::vulkan::Device::getBackendTextureMemorySize(void* backend_handle) {
+    if (backend_handle == nullptr) {
+        return 0;
+    }
+
+    return m_NVRHIDevice->getTextureMemoryRequirements(static_cast<nvrhi::ITexture*>(backend_handle)).size;
 }
 
 void rhi::vulkan::Device::DestroyBackendTexture(void* backend_handle) {
@@ -136,6 +184,166 @@ void rhi::vulkan::Device::DestroyBackendTexture(void* backend_handle) {
     backend_handle = nullptr;
 }
 
+RHI_NODISCARD rhi::MemoryBudget rhi::vulkan::Device::getMemoryBudget() {
+    VkPhysicalDeviceMemoryBudgetPropertiesEXT budget_properties{};
+    budget_properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+
+    VkPhysicalDeviceMemoryProperties2 properties{};
+    properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+    properties.pNext = m_MemoryBudgetSupported ? &budget_properties : nullptr;
+
+    vkGetPhysicalDeviceMemoryProperties2(m_Context.physical_device, &properties);
+
+    // without VK_EXT_memory_budget the whole heap is the budget and the usage is unknown
+    rhi::MemoryBudget budget{};
+    for (uint32_t i = 0; i < properties.memoryProperties.memoryHeapCount; i++) {
+        const auto& heap = properties.memoryProperties.memoryHeaps[i];
+        if ((heap.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) == 0u) continue;
+
+        budget.budget += m_MemoryBudgetSupported ? budget_properties.heapBudget[i] : heap.size;
+        budget.usage += m_MemoryBudgetSupported ? budget_properties.heapUsage[i] : 0;
+    }
+
+    return budget;
+}
+
+RHI_NODISCARD void* rhi::vulkan::Device::CreateBackendMemoryBlock(uint64_t size, rhi::CpuAccessMode cpu_access) {
+    nvrhi::HeapType type = nvrhi::HeapType::DeviceLocal;
+    if (cpu_access == rhi::CpuAccessMode::Write) type = nvrhi::HeapType::Upload;
+    if (cpu_access == rhi::CpuAccessMode::Read) type = nvrhi::HeapType::Readback;
+
+    nvrhi::HeapDesc desc{};
+    desc.setCapacity(size);
+    desc.setType(type);
+    desc.setDebugName("rhi::ResourceManager buffer block");
+
+    nvrhi::HeapHandle heap = m_NVRHIDevice->createHeap(desc);
+    return static_cast<void*>(heap.Detach()); // the reference is dropped by DestroyBackendMemoryBlock
+}
+
+void rhi::vulkan::Device::DestroyBackendMemoryBlock(void* backend_block) {
+    if (backend_block == nullptr) {
+        return;
+    }
+
+    // placed buffers hold their own reference to the heap, so this never frees memory still in use
+    static_cast<nvrhi::IHeap*>(backend_block)->Release();
+}
+
+RHI_NODISCARD void* rhi::vulkan::Device::CreateBackendBuffer(const rhi::BufferDesc& desc, bool placed) {
+    nvrhi::BufferDesc buffer_desc = rhi::to_nvrhi(desc);
+    buffer_desc.setIsVirtual(placed);
+
+    nvrhi::BufferHandle handle = m_NVRHIDevice->createBuffer(buffer_desc);
+    return static_cast<void*>(handle.Detach()); // the reference is dropped by DestroyBackendBuffer
+}
+
+RHI_NODISCARD rhi::MemoryRequirements rhi::vulkan::Device::getBackendBufferMemoryRequirements(void* backend_handle) {
+    nvrhi::MemoryRequirements requirements = m_NVRHIDevice->getBufferMemoryRequirements(static_cast<nvrhi::IBuffer*>(backend_handle));
+
+    rhi::MemoryRequirements result{};
+    result.size      = requirements.size;
+    result.alignment = requirements.alignment;
+    return result;
+}
+
+RHI_NODISCARD bool rhi::vulkan::Device::BindBackendBufferMemory(void* backend_handle, void* backend_block, uint64_t offset) {
+    return m_NVRHIDevice->bindBufferMemory(static_cast<nvrhi::IBuffer*>(backend_handle), static_cast<nvrhi::IHeap*>(backend_block), offset);
+}
+
+void rhi::vulkan::Device::DestroyBackendBuffer(void* backend_handle) {
+    if (backend_handle == nullptr) {
+        return;
+    }
+
+    static_cast<nvrhi::IBuffer*>(backend_handle)->Release();
+}
+
+void rhi::vulkan::Device::UploadBackendBuffer(void* backend_handle, uint64_t offset, const void* data, uint64_t size) {
+    m_Uploader.UploadBuffer(static_cast<nvrhi::IBuffer*>(backend_handle), offset, data, size);
+}
+
+void rhi::vulkan::Device::UploadBackendTexture(void* backend_handle, uint32_t mip_level, uint32_t array_slice, const void* data, uint64_t row_pitch) {
+    m_Uploader.UploadTexture(static_cast<nvrhi::ITexture*>(backend_handle), mip_level, array_slice, data, row_pitch);
+}
+
+void rhi::vulkan::Device::CopyBackendTextureMips(void* destination, uint32_t destination_mip, void* source, uint32_t source_mip, uint32_t mip_count) {
+    auto* dst_texture = static_cast<nvrhi::ITexture*>(destination);
+    auto* src_texture = static_cast<nvrhi::ITexture*>(source);
+    if (dst_texture == nullptr || src_texture == nullptr || mip_count == 0) {
+        return;
+    }
+
+    const auto& dst_desc = dst_texture->getDesc();
+    const auto& src_desc = src_texture->getDesc();
+    const auto& info     = nvrhi::getFormatInfo(src_desc.format);
+
+    if (source_mip + mip_count > src_desc.mipLevels || destination_mip + mip_count > dst_desc.mipLevels ||
+        src_desc.arraySize != dst_desc.arraySize || src_desc.format != dst_desc.format || info.hasDepth || info.hasStencil) {
+        rhi::logging::error("Device::CopyBackendTextureMips : %u mips do not fit both textures, or depth format", mip_count);
+        return;
+    }
+
+    if (!m_RecordingTextureCopies) {
+        m_TextureCopyCommandList->open();
+        m_RecordingTextureCopies = true;
+    }
+
+    VkCommandBuffer cmd       = m_TextureCopyCommandList->getNativeObject(nvrhi::ObjectTypes::VK_CommandBuffer);
+    VkImage         src_image = src_texture->getNativeObject(nvrhi::ObjectTypes::VK_Image);
+    VkImage         dst_image = dst_texture->getNativeObject(nvrhi::ObjectTypes::VK_Image);
+
+    // the destination mips are overwritten as a whole, so their old contents can be discarded
+    VkImageMemoryBarrier to_transfer[2]{};
+    to_transfer[0].sType               = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    to_transfer[0].srcAccessMask       = VK_ACCESS_SHADER_READ_BIT;
+    to_transfer[0].dstAccessMask       = VK_ACCESS_TRANSFER_READ_BIT;
+    to_transfer[0].oldLayout           = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    to_transfer[0].newLayout           = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    to_transfer[0].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    to_transfer[0].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    to_transfer[0].image               = src_image;
+    to_transfer[0].subresourceRange    = { VK_IMAGE_ASPECT_COLOR_BIT, source_mip, mip_count, 0, src_desc.arraySize };
+
+    to_transfer[1]                  = to_transfer[0];
+    to_transfer[1].srcAccessMask    = 0;
+    to_transfer[1].dstAccessMask    = VK_ACCESS_TRANSFER_WRITE_BIT;
+    to_transfer[1].oldLayout        = VK_IMAGE_LAYOUT_UNDEFINED;
+    to_transfer[1].newLayout        = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    to_transfer[1].image            = dst_image;
+    to_transfer[1].subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, destination_mip, mip_count, 0, dst_desc.arraySize };
+
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                         0, nullptr, 0, nullptr, 2, to_transfer);
+
+    std::vector<VkImageCopy> regions(mip_count);
+    for (uint32_t i = 0; i < mip_count; i++) {
+        uint32_t mip = source_mip + i;
+
+        regions[i].srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, mip, 0, src_desc.arraySize };
+        regions[i].dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, destination_mip + i, 0, dst_desc.arraySize };
+        regions[i].extent         = { std::max(src_desc.width >> mip, 1u),
+                                      std::max(src_desc.height >> mip, 1u),
+                                      src_desc.dimension == nvrhi::TextureDimension::Texture3D ? std::max(src_desc.depth >> mip, 1u) : 1u };
+    }
+
+    vkCmdCopyImage(cmd, src_image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, dst_image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                   mip_count, regions.data());
+
+    VkImageMemoryBarrier to_shader[2] = { to_transfer[0], to_transfer[1] };
+    to_shader[0].srcAccessMask        = VK_ACCESS_TRANSFER_READ_BIT;
+    to_shader[0].dstAccessMask        = VK_ACCESS_SHADER_READ_BIT;
+    to_shader[0].oldLayout            = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    to_shader[0].newLayout            = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    to_shader[1].srcAccessMask        = VK_ACCESS_TRANSFER_WRITE_BIT;
+    to_shader[1].dstAccessMask        = VK_ACCESS_SHADER_READ_BIT;
+    to_shader[1].oldLayout            = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    to_shader[1].newLayout            = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0,
+                         0, nullptr, 0, nullptr, 2, to_shader);
+}
+
 void rhi::vulkan::Device::CreateInstance() {
     if (ENABLE_VALIDATION_LAYERS && !checkValidationLayerSupport()) {
         rhi::logging::warning("Validation layers requested, but not available");
@@ -231,6 +439,11 @@ void rhi::vulkan::Device::CreateLogicalDevice() {
         rhi::logging::fatal("Failed to find queue families");
     }
 
+    // optional, getMemoryBudget falls back to the heap sizes without it
+    m_MemoryBudgetSupported = checkDeviceExtensionSupport(m_Context.physical_device, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+    if (m_MemoryBudgetSupported)
+        m_EnabledExtensions.device.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+
     std::vector<VkDeviceQueueCreateInfo> queue_create_infos{};
     std::unordered_set<uint32_t>         unique_queue_families{};
 
@@ -280,6 +493,8 @@ void rhi::vulkan::Device::CreateLogicalDevice() {
 
     vkGetDeviceQueue(m_Context.device, m_QueueFamilyIndices.graphics_family.value(), 0, &m_Context.graphics_queue);
     vkGetDeviceQueue(m_Context.device, m_QueueFamilyIndices.present_family.value(), 0, &m_Context.present_queue);
+    vkGetDeviceQueue(m_Context.device, m_QueueFamilyIndices.compute_family.value(), 0, &m_Context.compute_queue);
+    vkGetDeviceQueue(m_Context.device, m_QueueFamilyIndices.transfer_family.value(), 0, &m_Context.transfer_queue);
 }
 
 void rhi::vulkan::Device::CreateCommandPool() {
@@ -315,7 +530,7 @@ void rhi::vulkan::Device::CreateSyncObjects() {
     fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
     fence_info.flags = VK_FENCE_CREATE_SIGNALED_BIT;
 
-    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) { // TODO : Add m_Frames[i].frame_complete creation
+    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) { // m_Frames[i].frame_complete is created with the NVRHI device
 
         RHI_VK_CHECK_FATAL(vkCreateSemaphore(m_Context.device, &semaphore_info, nullptr, &m_Frames[i].image_available),
                            "Failed to create image available semaphore");
@@ -335,11 +550,24 @@ void rhi::vulkan::Device::CreateNVRHIDevice() {
     device_desc.device              = m_Context.device;
     device_desc.graphicsQueue       = m_Context.graphics_queue;
     device_desc.graphicsQueueIndex  = m_QueueFamilyIndices.graphics_family.value();
+    device_desc.computeQueue        = m_Context.compute_queue;
+    device_desc.computeQueueIndex   = m_QueueFamilyIndices.compute_family.value();
+    device_desc.transferQueue       = m_Context.transfer_queue;
+    device_desc.transferQueueIndex  = m_QueueFamilyIndices.transfer_family.value();
     device_desc.deviceExtensions    = m_EnabledExtensions.device.data();
     device_desc.numDeviceExtensions = m_EnabledExtensions.device.size();
 
     m_NVRHIDevice = nvrhi::vulkan::createDevice(device_desc);
 
+    for (auto& frame : m_Frames)
+        frame.frame_complete = m_NVRHIDevice->createEventQuery();
+
+    m_Uploader.Initialize();
+
+    m_TextureCopyCommandList = m_NVRHIDevice->createCommandList(nvrhi::CommandListParameters()
+                                                                    .setQueueType(nvrhi::CommandQueue::Graphics)
+                                                                    .setEnableImmediateExecution(false));
+
     if (ENABLE_VALIDATION_LAYERS) {
         nvrhi::DeviceHandle nvrhi_validation_layer = nvrhi::validation::createValidationLayer(m_NVRHIDevice);
         m_ValidationLayer                          = nvrhi_validation_layer; // TODO : make the rest of the application go through the validation layer
@@ -411,6 +639,18 @@ RHI_NODISCARD bool rhi::vulkan::Device::checkDeviceExtensionSupport(VkPhysicalDe
     return required_extensions.empty();
 }
 
+RHI_NODISCARD bool rhi::vulkan::Device::checkDeviceExtensionSupport(VkPhysicalDevice device, const char* extension) {
+    uint32_t extension_count = 0;
+    vkEnumerateDeviceExtensionProperties(device, nullptr, &extension_count, nullptr);
+
+    std::vector<VkExtensionProperties> available_extensions(extension_count);
+    vkEnumerateDeviceExtensionProperties(device, nullptr, &extension_count, available_extensions.data());
+
+    return std::any_of(available_extensions.begin(), available_extensions.end(), [extension](const VkExtensionProperties& available) {
+        return std::strcmp(available.extensionName, extension) == 0;
+    });
+}
+
 RHI_NODISCARD bool rhi::vulkan::Device::isDeviceSuitable(VkPhysicalDevice device) {
     bool found = findQueueFamilies(device);
     if (!found) return false;
@@ -18,6 +18,7 @@
 
 #include "RHI/Device.hpp"
 #include "Misc.hpp"
+#include "Uploader.hpp"
 
 #include "Swapchain.hpp" // remove this
 
@@ -56,8 +57,27 @@ namespace rhi::vulkan {
         RHI_NODISCARD std::unique_ptr<rhi::Swapchain> CreateSwapchain() override;
         void                                          Submit(rhi::CommandList* cmd) override;
 
-        RHI_NODISCARD void* CreateBackendTexture(const rhi::TextureDesc& desc) override;
-        void                DestroyBackendTexture(void* backend_handle) override;
+        RHI_NODISCARD uint64_t getFrameNumber() const override { return m_FrameNumber; }
+        RHI_NODISCARD uint64_t getCompletedFrameNumber() override;
+        void                   WaitForIdle() override;
+
+        RHI_NODISCARD void*    CreateBackendTexture(const rhi::TextureDesc& desc) override;
+        RHI_NODISCARD uint64_t getBackendTextureMemorySize(void* backend_handle) override;
+        void                   DestroyBackendTexture(void* backend_handle) override;
+
+        RHI_NODISCARD rhi::MemoryBudget getMemoryBudget() override;
+
+        RHI_NODISCARD void* CreateBackendMemoryBlock(uint64_t size, rhi::CpuAccessMode cpu_access) override;
+        void                DestroyBackendMemoryBlock(void* backend_block) override;
+
+        RHI_NODISCARD void*                   CreateBackendBuffer(const rhi::BufferDesc& desc, bool placed) override;
+        RHI_NODISCARD rhi::MemoryRequirements getBackendBufferMemoryRequirements(void* backend_handle) override;
+        RHI_NODISCARD bool                    BindBackendBufferMemory(void* backend_handle, void* backend_block, uint64_t offset) override;
+        void                                  DestroyBackendBuffer(void* backend_handle) override;
+
+        void UploadBackendBuffer(void* backend_handle, uint64_t offset, const void* data, uint64_t size) override;
+        void UploadBackendTexture(void* backend_handle, uint32_t mip_level, uint32_t array_slice, const void* data, uint64_t row_pitch) override;
+        void CopyBackendTextureMips(void* destination, uint32_t destination_mip, void* source, uint32_t source_mip, uint32_t mip_count) override;
 
         inline RHI_NODISCARD Swapchain::SwapchainImage& getSwapchainImage(uint32_t) {  } // TODO : Rewrite
 
@@ -77,6 +97,7 @@ namespace rhi::vulkan {
         RHI_NODISCARD static std::vector<const char*> getRequiredExtensions();
         static void                                   populateDebugMessengerCreateInfo(VkDebugUtilsMessengerCreateInfoEXT& create_info);
         RHI_NODISCARD bool                            checkDeviceExtensionSupport(VkPhysicalDevice device);
+        RHI_NODISCARD static bool                     checkDeviceExtensionSupport(VkPhysicalDevice device, const char* extension);
         RHI_NODISCARD bool                            isDeviceSuitable(VkPhysicalDevice device);
         RHI_NODISCARD bool                            findQueueFamilies(VkPhysicalDevice physical_device);
         void                                          findSwapchainSupportDetails(VkPhysicalDevice device);
@@ -150,7 +171,8 @@ namespace rhi::vulkan {
         uint32_t     m_SurfaceWidth  = 0;
         uint32_t     m_SurfaceHeight = 0;
 
-        VkSampleCountFlagBits   m_MSAA_Samples = VK_SAMPLE_COUNT_1_BIT;
+        VkSampleCountFlagBits   m_MSAA_Samples          = VK_SAMPLE_COUNT_1_BIT;
+        bool                    m_MemoryBudgetSupported = false; // VK_EXT_memory_budget is enabled
         QueueFamilyIndices      m_QueueFamilyIndices;
         SwapchainSupportDetails m_SwapchainSupportDetails;
 
@@ -162,8 +184,15 @@ namespace rhi::vulkan {
         nvrhi::vulkan::DeviceHandle m_NVRHIDevice;
         nvrhi::DeviceHandle         m_ValidationLayer;
 
+        Uploader m_Uploader{ *this };
+
+        nvrhi::CommandListHandle m_TextureCopyCommandList; // CopyBackendTextureMips of the frame being recorded
+        bool                     m_RecordingTextureCopies = false;
+
         std::vector<FrameSync> m_Frames;
-        uint32_t               m_FrameIndex;
+        uint32_t               m_FrameIndex           = 0; // m_FrameNumber % MAX_FRAMES_IN_FLIGHT
+        uint64_t               m_FrameNumber          = 0;
+        uint64_t               m_CompletedFrameNumber = 0;
 
         //#if VK_HEADER_VERSION >= 301
         //        typedef vk::detail::DynamicLoader VulkanDynamicLoader;
@@ -174,5 +203,6 @@ namespace rhi::vulkan {
         //        std::unique_ptr<VulkanDynamicLoader> m_DynamicLoader;
 
         friend class rhi::vulkan::Swapchain;
+        friend class rhi::vulkan::Uploader;
     };
 } // namespace rhi::vulkan
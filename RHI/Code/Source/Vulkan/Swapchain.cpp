@@ -135,7 +135,7 @@ void rhi::vulkan::Swapchain::CreateNVRHIFramebuffers() {
     }
 }
 
-RHI_NODISCARD rhi::TextureHandle rhi::vulkan::Swapchain::Acquire() {
+RHI_NODISCARD rhi::Swapchain::BackbufferIndex rhi::vulkan::Swapchain::Acquire() {
     auto  device = m_Device.m_Context.device;
     auto& frame  = m_Device.m_Frames[m_Device.m_FrameIndex];
 
@@ -0,0 +1,317 @@
+/*=================================================
+
+    Copyright (C) 2025 Farrakh. All Rights Reserved.
+
+    This file is a part of ArchitectureTestAdventure.
+    Check README.md for more information.
+
+    File : Uploader.cpp
+
+    Content : staging ring buffer and transfer queue uploads. A part of Vulkan backend
+
+=================================================*/
+
+#include "Uploader.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+#include "Device.hpp"
+#include "Logging.hpp"
+
+void rhi::vulkan::Uploader::Initialize() {
+    auto& device = m_Device.m_NVRHIDevice;
+
+    nvrhi::BufferDesc ring_desc{};
+    ring_desc.setByteSize(RING_SIZE);
+    ring_desc.setCpuAccess(nvrhi::CpuAccessMode::Write);
+    ring_desc.setInitialState(nvrhi::ResourceStates::CopySource);
+    ring_desc.setKeepInitialState(true);
+    ring_desc.setDebugName("rhi::vulkan::Uploader ring");
+
+    m_Ring       = device->createBuffer(ring_desc);
+    m_RingData   = static_cast<uint8_t*>(device->mapBuffer(m_Ring, nvrhi::CpuAccessMode::Write));
+    m_RingBuffer = m_Ring->getNativeObject(nvrhi::ObjectTypes::VK_Buffer);
+
+    if (m_RingData == nullptr) {
+        rhi::logging::fatal("Failed to map the upload ring buffer");
+    }
+
+    m_CopyCommandList    = device->createCommandList(nvrhi::CommandListParameters()
+                                                         .setQueueType(nvrhi::CommandQueue::Copy)
+                                                         .setEnableImmediateExecution(false));
+    m_AcquireCommandList = device->createCommandList(nvrhi::CommandListParameters()
+                                                         .setQueueType(nvrhi::CommandQueue::Graphics)
+                                                         .setEnableImmediateExecution(false));
+}
+
+void rhi::vulkan::Uploader::Release() {
+    if (!m_Ring) {
+        return;
+    }
+
+    this->Flush();
+    m_Device.m_NVRHIDevice->waitForIdle();
+    m_Device.m_NVRHIDevice->unmapBuffer(m_Ring);
+
+    m_Ring       = nullptr;
+    m_RingBuffer = VK_NULL_HANDLE;
+    m_RingData   = nullptr;
+    m_Head       = 0;
+    m_Tail       = 0;
+
+    m_CopyCommandList    = nullptr;
+    m_AcquireCommandList = nullptr;
+
+    m_Batches.clear();
+    m_FreeQueries.clear();
+    m_ReleaseBuffers.clear();
+    m_ReleaseImages.clear();
+    m_AcquireBuffers.clear();
+    m_AcquireImages.clear();
+}
+
+void rhi::vulkan::Uploader::UploadBuffer(nvrhi::IBuffer* buffer, uint64_t offset, const void* data, uint64_t size) {
+    if (buffer == nullptr || data == nullptr || size == 0) {
+        return;
+    }
+
+    if (offset + size > buffer->getDesc().byteSize) {
+        rhi::logging::error("Uploader::UploadBuffer : %llu bytes at offset %llu do not fit into the buffer", size, offset);
+        return;
+    }
+
+    VkBuffer    destination = buffer->getNativeObject(nvrhi::ObjectTypes::VK_Buffer);
+    const auto* source      = static_cast<const uint8_t*>(data);
+
+    for (uint64_t done = 0; done < size;) {
+        uint64_t chunk        = std::min(size - done, MAX_COPY_CHUNK);
+        uint64_t ring_offset  = this->allocate(chunk, 16);
+        std::memcpy(m_RingData + ring_offset, source + done, chunk);
+
+        VkBufferCopy region{};
+        region.srcOffset = ring_offset;
+        region.dstOffset = offset + done;
+        region.size      = chunk;
+
+        vkCmdCopyBuffer(this->getCommandBuffer(), m_RingBuffer, destination, 1, &region);
+        done += chunk;
+    }
+
+    VkBufferMemoryBarrier release{};
+    release.sType               = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    release.srcAccessMask       = VK_ACCESS_TRANSFER_WRITE_BIT;
+    release.dstAccessMask       = 0;
+    release.srcQueueFamilyIndex = m_Device.m_QueueFamilyIndices.transfer_family.value();
+    release.dstQueueFamilyIndex = m_Device.m_QueueFamilyIndices.graphics_family.value();
+    release.buffer              = destination;
+    release.offset              = offset;
+    release.size                = size;
+    m_ReleaseBuffers.push_back(release);
+}
+
+void rhi::vulkan::Uploader::UploadTexture(nvrhi::ITexture* texture, uint32_t mip_level, uint32_t array_slice, const void* data, uint64_t row_pitch) {
+    if (texture == nullptr || data == nullptr) {
+        return;
+    }
+
+    const auto& desc = texture->getDesc();
+    const auto& info = nvrhi::getFormatInfo(desc.format);
+
+    if (mip_level >= desc.mipLevels || array_slice >= desc.arraySize || info.hasDepth || info.hasStencil) {
+        rhi::logging::error("Uploader::UploadTexture : invalid subresource ( mip %u, slice %u ) or depth format", mip_level, array_slice);
+        return;
+    }
+
+    uint32_t width  = std::max(desc.width >> mip_level, 1u);
+    uint32_t height = std::max(desc.height >> mip_level, 1u);
+    uint32_t depth  = desc.dimension == nvrhi::TextureDimension::Texture3D ? std::max(desc.depth >> mip_level, 1u) : 1u;
+
+    // rows are rows of blocks for compressed formats
+    uint64_t block_columns = (width + info.blockSize - 1) / info.blockSize;
+    uint64_t block_rows    = (height + info.blockSize - 1) / info.blockSize;
+    if (row_pitch < block_columns * info.bytesPerBlock || row_pitch % info.bytesPerBlock != 0) {
+        rhi::logging::error("Uploader::UploadTexture : row pitch %llu does not match the format", row_pitch);
+        return;
+    }
+
+    // bufferOffset has to be a multiple of both 4 and the block size
+    uint64_t alignment      = info.bytesPerBlock % 4 == 0 ? info.bytesPerBlock : uint64_t(info.bytesPerBlock) * 4;
+    uint64_t rows_per_chunk = std::max<uint64_t>(MAX_COPY_CHUNK / row_pitch, 1);
+
+    VkImage                 image = texture->getNativeObject(nvrhi::ObjectTypes::VK_Image);
+    VkImageSubresourceRange range{ VK_IMAGE_ASPECT_COLOR_BIT, mip_level, 1, array_slice, 1 };
+
+    // the whole subresource is overwritten, so its old contents can be discarded
+    VkImageMemoryBarrier to_transfer{};
+    to_transfer.sType               = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    to_transfer.srcAccessMask       = 0;
+    to_transfer.dstAccessMask       = VK_ACCESS_TRANSFER_WRITE_BIT;
+    to_transfer.oldLayout           = VK_IMAGE_LAYOUT_UNDEFINED;
+    to_transfer.newLayout           = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    to_transfer.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    to_transfer.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    to_transfer.image               = image;
+    to_transfer.subresourceRange    = range;
+
+    vkCmdPipelineBarrier(this->getCommandBuffer(), VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                         0, nullptr, 0, nullptr, 1, &to_transfer);
+
+    const auto* source = static_cast<const uint8_t*>(data);
+    for (uint32_t z = 0; z < depth; z++) {
+        for (uint64_t row = 0; row < block_rows; row += rows_per_chunk) {
+            uint64_t rows        = std::min(rows_per_chunk, block_rows - row);
+            uint64_t bytes       = rows * row_pitch;
+            uint64_t ring_offset = this->allocate(bytes, alignment);
+            std::memcpy(m_RingData + ring_offset, source + (z * block_rows + row) * row_pitch, bytes);
+
+            VkBufferImageCopy region{};
+            region.bufferOffset      = ring_offset;
+            region.bufferRowLength   = static_cast<uint32_t>(row_pitch / info.bytesPerBlock * info.blockSize);
+            region.bufferImageHeight = 0;
+            region.imageSubresource  = { VK_IMAGE_ASPECT_COLOR_BIT, mip_level, array_slice, 1 };
+            region.imageOffset       = { 0, static_cast<int32_t>(row * info.blockSize), static_cast<int32_t>(z) };
+            region.imageExtent       = { width, std::min(static_cast<uint32_t>(rows * info.blockSize), height - static_cast<uint32_t>(row * info.blockSize)), 1 };
+
+            vkCmdCopyBufferToImage(this->getCommandBuffer(), m_RingBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+        }
+    }
+
+    // the layout change to SHADER_READ_ONLY_OPTIMAL rides on the ownership transfer
+    VkImageMemoryBarrier release{};
+    release.sType               = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    release.srcAccessMask       = VK_ACCESS_TRANSFER_WRITE_BIT;
+    release.dstAccessMask       = 0;
+    release.oldLayout           = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    release.newLayout           = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    release.srcQueueFamilyIndex = m_Device.m_QueueFamilyIndices.transfer_family.value();
+    release.dstQueueFamilyIndex = m_Device.m_QueueFamilyIndices.graphics_family.value();
+    release.image               = image;
+    release.subresourceRange    = range;
+    m_ReleaseImages.push_back(release);
+}
+
+void rhi::vulkan::Uploader::Flush() {
+    if (!m_Recording) {
+        return;
+    }
+
+    auto& device = m_Device.m_NVRHIDevice;
+
+    if (!m_ReleaseBuffers.empty() || !m_ReleaseImages.empty()) {
+        vkCmdPipelineBarrier(this->getCommandBuffer(), VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+                             0, nullptr,
+                             static_cast<uint32_t>(m_ReleaseBuffers.size()), m_ReleaseBuffers.data(),
+                             static_cast<uint32_t>(m_ReleaseImages.size()), m_ReleaseImages.data());
+    }
+
+    m_CopyCommandList->close();
+    m_Recording = false;
+
+    nvrhi::ICommandList* lists[] = {
+        m_CopyCommandList
+    };
+
+    m_LastCopyInstance = device->executeCommandLists(lists, 1, nvrhi::CommandQueue::Copy);
+
+    Batch batch{};
+    if (!m_FreeQueries.empty()) {
+        batch.complete = std::move(m_FreeQueries.back());
+        m_FreeQueries.pop_back();
+        device->resetEventQuery(batch.complete);
+    } else {
+        batch.complete = device->createEventQuery();
+    }
+    device->setEventQuery(batch.complete, nvrhi::CommandQueue::Copy);
+    batch.ring_end = m_Head;
+    m_Batches.push_back(std::move(batch));
+
+    // the graphics queue acquires the same ranges, with the access masks on its side
+    for (auto barrier : m_ReleaseBuffers) {
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+        m_AcquireBuffers.push_back(barrier);
+    }
+
+    for (auto barrier : m_ReleaseImages) {
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        m_AcquireImages.push_back(barrier);
+    }
+
+    m_ReleaseBuffers.clear();
+    m_ReleaseImages.clear();
+}
+
+RHI_NODISCARD nvrhi::ICommandList* rhi::vulkan::Uploader::RecordAcquire() {
+    if (m_AcquireBuffers.empty() && m_AcquireImages.empty()) {
+        return nullptr;
+    }
+
+    // the next graphics submission waits on the semaphore the copy queue signals for this instance
+    m_Device.m_NVRHIDevice->queueWaitForCommandList(nvrhi::CommandQueue::Graphics, nvrhi::CommandQueue::Copy, m_LastCopyInstance);
+
+    m_AcquireCommandList->open();
+
+    VkCommandBuffer cmd = m_AcquireCommandList->getNativeObject(nvrhi::ObjectTypes::VK_CommandBuffer);
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0,
+                         0, nullptr,
+                         static_cast<uint32_t>(m_AcquireBuffers.size()), m_AcquireBuffers.data(),
+                         static_cast<uint32_t>(m_AcquireImages.size()), m_AcquireImages.data());
+
+    m_AcquireCommandList->close();
+
+    m_AcquireBuffers.clear();
+    m_AcquireImages.clear();
+
+    return m_AcquireCommandList;
+}
+
+RHI_NODISCARD uint64_t rhi::vulkan::Uploader::allocate(uint64_t size, uint64_t alignment) {
+    assert(size <= MAX_COPY_CHUNK);
+
+    this->retireBatches(false);
+
+    while (true) {
+        uint64_t position = m_Head % RING_SIZE;
+        uint64_t aligned  = (position + alignment - 1) / alignment * alignment;
+
+        // a range never wraps around the end of the ring, the rest of the ring is skipped instead
+        uint64_t start = aligned + size <= RING_SIZE ? m_Head + (aligned - position) : m_Head + (RING_SIZE - position);
+        if (start + size - m_Tail <= RING_SIZE) {
+            m_Head = start + size;
+            return start % RING_SIZE;
+        }
+
+        // full : what was recorded so far has to be submitted before its space can come back
+        this->Flush();
+        this->retireBatches(true);
+    }
+}
+
+void rhi::vulkan::Uploader::retireBatches(bool wait_for_one) {
+    auto& device = m_Device.m_NVRHIDevice;
+
+    while (!m_Batches.empty()) {
+        auto& batch = m_Batches.front();
+        if (!device->pollEventQuery(batch.complete)) {
+            if (!wait_for_one) break;
+            device->waitEventQuery(batch.complete);
+        }
+
+        wait_for_one = false;
+        m_Tail       = batch.ring_end;
+        m_FreeQueries.push_back(std::move(batch.complete));
+        m_Batches.pop_front();
+    }
+}
+
+RHI_NODISCARD VkCommandBuffer rhi::vulkan::Uploader::getCommandBuffer() {
+    if (!m_Recording) {
+        m_CopyCommandList->open();
+        m_Recording = true;
+    }
+
+    return m_CopyCommandList->getNativeObject(nvrhi::ObjectTypes::VK_CommandBuffer);
+}
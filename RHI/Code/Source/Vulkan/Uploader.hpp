@@ -0,0 +1,94 @@
+/*=================================================
+
+    Copyright (C) 2025 Farrakh. All Rights Reserved.
+
+    This file is a part of ArchitectureTestAdventure.
+    Check README.md for more information.
+
+    File : Uploader.hpp
+
+    Content : staging ring buffer and transfer queue uploads. A part of Vulkan backend
+
+=================================================*/
+
+#pragma once
+
+#include <deque>
+#include <vector>
+
+#include <nvrhi/vulkan.h>
+
+#include "Common/Attributes.hpp"
+
+namespace rhi::vulkan {
+    class Device;
+
+    // streams resource contents to the GPU through one persistently mapped staging ring buffer.
+    // Copies are recorded into a single transfer queue command list, which Flush submits once per frame
+    // ( or early, when the ring runs full ). The transfer queue releases the written ranges to the graphics
+    // queue family and RecordAcquire builds the matching acquire, whose submission waits on the transfer
+    // submission through NVRHI's queue semaphore.
+    //
+    // The destination must not be in use by the graphics queue : this path is for initial contents
+    // of new buffers and texture subresources. Textures end up in SHADER_READ_ONLY_OPTIMAL, so they should
+    // track their state from ResourceStates::ShaderResource ( TextureDesc::enableAutomaticStateTracking )
+    class Uploader {
+    public:
+        constexpr static uint64_t RING_SIZE      = uint64_t(64) << 20;
+        constexpr static uint64_t MAX_COPY_CHUNK = RING_SIZE / 4; // bigger uploads are split, so one never fills the ring
+
+    public:
+        Uploader(Device& device) : m_Device(device) {}
+        ~Uploader() = default;
+
+        void Initialize();
+        void Release();
+
+        void UploadBuffer(nvrhi::IBuffer* buffer, uint64_t offset, const void* data, uint64_t size);
+        void UploadTexture(nvrhi::ITexture* texture, uint32_t mip_level, uint32_t array_slice, const void* data, uint64_t row_pitch);
+
+        // submits the copies recorded since the last Flush
+        void Flush();
+
+        // the graphics command list that acquires everything flushed so far, nullptr if there is nothing to acquire.
+        // It has to run before the graphics work that uses the uploads, in the next graphics submission
+        RHI_NODISCARD nvrhi::ICommandList* RecordAcquire();
+
+    private:
+        // returns the ring offset of size bytes, waits for the transfer queue when the ring is full
+        RHI_NODISCARD uint64_t allocate(uint64_t size, uint64_t alignment);
+        void                   retireBatches(bool wait_for_one);
+
+        RHI_NODISCARD VkCommandBuffer getCommandBuffer();
+
+    private:
+        struct Batch {
+        public:
+            nvrhi::EventQueryHandle complete;
+            uint64_t                ring_end; // m_Head when the batch was submitted
+        };
+
+    private:
+        Device& m_Device;
+
+        nvrhi::BufferHandle m_Ring;
+        VkBuffer            m_RingBuffer = VK_NULL_HANDLE;
+        uint8_t*            m_RingData   = nullptr; // mapped for the whole lifetime of the ring
+        uint64_t            m_Head       = 0;       // monotonic, m_Head % RING_SIZE is the next write position
+        uint64_t            m_Tail       = 0;       // everything before m_Tail has been consumed by the GPU
+
+        nvrhi::CommandListHandle m_CopyCommandList;
+        nvrhi::CommandListHandle m_AcquireCommandList;
+        bool                     m_Recording = false;
+
+        std::deque<Batch>                    m_Batches;
+        std::vector<nvrhi::EventQueryHandle> m_FreeQueries;
+        uint64_t                             m_LastCopyInstance = 0;
+
+        // ownership transfers of the batch being recorded, and of the submitted ones not acquired yet
+        std::vector<VkBufferMemoryBarrier> m_ReleaseBuffers;
+        std::vector<VkImageMemoryBarrier>  m_ReleaseImages;
+        std::vector<VkBufferMemoryBarrier> m_AcquireBuffers;
+        std::vector<VkImageMemoryBarrier>  m_AcquireImages;
+    };
+} // namespace rhi::vulkan